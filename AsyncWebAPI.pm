@@ -3,6 +3,7 @@ package AsyncWebAPI;
 use strict;
 use warnings;
 use Exporter qw(import);
+use ZeroPerl::JSON ();
 
 our @EXPORT_OK = qw(fetch sleep_ms await);
 our @EXPORT = @EXPORT_OK;
@@ -89,17 +90,16 @@ sub await {
 
 # Helper functions
 
+# UTF-8 bytes, as _async_fetch passes the string on as a C string
+my $HEADERS_JSON = ZeroPerl::JSON->new->utf8;
+
 sub _encode_headers {
     my ($headers) = @_;
     
     return '{}' unless ref($headers) eq 'HASH';
     
-    my @pairs;
-    for my $key (keys %$headers) {
-        push @pairs, "\"$key\":\"$headers->{$key}\"";
-    }
-    
-    return '{' . join(',', @pairs) . '}';
+    # Header values are strings on the JavaScript side, so stringify numbers
+    return $HEADERS_JSON->encode({ map { $_ => "$headers->{$_}" } keys %$headers });
 }
 
 sub _decode_json_response {
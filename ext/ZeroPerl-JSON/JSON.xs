@@ -0,0 +1,997 @@
+// ZeroPerl::JSON: JSON encoder/decoder in C, built as a static extension
+// (static_ext in hints-wasi.sh) and booted from xs_init in zeroperl.c.
+// lib/ZeroPerl/JSON.pm provides the JSON::PP compatible interface on top.
+
+#define PERL_NO_GET_CONTEXT
+#include "EXTERN.h"
+#include "perl.h"
+#include "XSUB.h"
+
+#include <math.h>
+#include <string.h>
+
+// Option bits, kept in $self->{flags}; exported to JSON.pm as %FLAGS
+#define F_ASCII 0x0001
+#define F_LATIN1 0x0002
+#define F_UTF8 0x0004
+#define F_INDENT 0x0008
+#define F_SPACE_BEFORE 0x0010
+#define F_SPACE_AFTER 0x0020
+#define F_CANONICAL 0x0040
+#define F_ALLOW_NONREF 0x0080
+#define F_ALLOW_BLESSED 0x0100
+#define F_CONVERT_BLESSED 0x0200
+#define F_ALLOW_UNKNOWN 0x0400
+#define F_RELAXED 0x0800
+
+#define F_DEFAULT F_ALLOW_NONREF
+
+#define JSON_MAX_DEPTH 512
+#define JSON_INDENT 3
+
+#define JSON_ERR_DEPTH                                                         \
+  "json text or perl structure exceeds maximum nesting level (max_depth set "  \
+  "too low?)"
+#define JSON_ERR_VALUE                                                         \
+  "malformed JSON string, neither tag, array, object, number, string or atom"
+
+static const struct {
+  const char *name;
+  U32 bit;
+} json_flags[] = {
+    {"ascii", F_ASCII},
+    {"latin1", F_LATIN1},
+    {"utf8", F_UTF8},
+    {"indent", F_INDENT},
+    {"space_before", F_SPACE_BEFORE},
+    {"space_after", F_SPACE_AFTER},
+    {"canonical", F_CANONICAL},
+    {"allow_nonref", F_ALLOW_NONREF},
+    {"allow_blessed", F_ALLOW_BLESSED},
+    {"convert_blessed", F_CONVERT_BLESSED},
+    {"allow_unknown", F_ALLOW_UNKNOWN},
+    {"relaxed", F_RELAXED},
+};
+
+typedef struct {
+  U32 flags;
+  U32 max_depth;
+  // Output SV, grown in place; cur/end point into its buffer
+  SV *sv;
+  char *cur;
+  char *end;
+  U32 indent;
+} json_enc;
+
+typedef struct {
+  U32 flags;
+  U32 max_depth;
+  const char *start;
+  const char *cur;
+  const char *end;
+  U32 depth;
+} json_dec;
+
+//
+// Encoder
+//
+
+static void enc_grow(pTHX_ json_enc *enc, STRLEN len) {
+  if ((STRLEN)(enc->end - enc->cur) >= len) {
+    return;
+  }
+  STRLEN used = enc->cur - SvPVX(enc->sv);
+  STRLEN want = used + len + 1;
+  STRLEN size = SvLEN(enc->sv);
+  while (size < want) {
+    size += size >> 1;
+  }
+  char *buf = SvGROW(enc->sv, size);
+  enc->cur = buf + used;
+  enc->end = buf + SvLEN(enc->sv) - 1;
+}
+
+static inline void enc_ch(pTHX_ json_enc *enc, char c) {
+  enc_grow(aTHX_ enc, 1);
+  *enc->cur++ = c;
+}
+
+static inline void enc_mem(pTHX_ json_enc *enc, const char *s, STRLEN len) {
+  enc_grow(aTHX_ enc, len);
+  memcpy(enc->cur, s, len);
+  enc->cur += len;
+}
+
+static void enc_newline(pTHX_ json_enc *enc) {
+  if (!(enc->flags & F_INDENT)) {
+    return;
+  }
+  enc_grow(aTHX_ enc, 1 + enc->indent * JSON_INDENT);
+  *enc->cur++ = '\n';
+  memset(enc->cur, ' ', enc->indent * JSON_INDENT);
+  enc->cur += enc->indent * JSON_INDENT;
+}
+
+static void enc_uescape(pTHX_ json_enc *enc, UV cp) {
+  char tmp[13];
+  int len;
+  if (cp >= 0x10000) {
+    cp -= 0x10000;
+    len = snprintf(tmp, sizeof tmp, "\\u%04x\\u%04x",
+                   (unsigned)(0xd800 + (cp >> 10)),
+                   (unsigned)(0xdc00 + (cp & 0x3ff)));
+  } else {
+    len = snprintf(tmp, sizeof tmp, "\\u%04x", (unsigned)cp);
+  }
+  enc_mem(aTHX_ enc, tmp, len);
+}
+
+// Writes one non-ASCII character, escaped if the output charset lacks it
+static void enc_char(pTHX_ json_enc *enc, UV cp) {
+  if ((enc->flags & F_ASCII) || ((enc->flags & F_LATIN1) && cp > 0xff)) {
+    enc_uescape(aTHX_ enc, cp);
+    return;
+  }
+  if (enc->flags & F_LATIN1) {
+    enc_ch(aTHX_ enc, (char)cp);
+    return;
+  }
+  enc_grow(aTHX_ enc, UTF8_MAXBYTES);
+  enc->cur = (char *)uvchr_to_utf8((U8 *)enc->cur, cp);
+}
+
+// Quoted string. The output buffer is UTF-8 unless latin1 or ascii is set;
+// non-UTF-8 input strings hold Latin-1 characters.
+static void enc_str(pTHX_ json_enc *enc, const char *s, STRLEN len,
+                    bool is_utf8) {
+  const U8 *p = (const U8 *)s;
+  const U8 *end = p + len;
+
+  enc_ch(aTHX_ enc, '"');
+  while (p < end) {
+    // Copy runs that need no escaping in one go
+    const U8 *run = p;
+    while (p < end && *p >= 0x20 && *p < 0x80 && *p != '"' && *p != '\\') {
+      p++;
+    }
+    if (p > run) {
+      enc_mem(aTHX_ enc, (const char *)run, p - run);
+    }
+    if (p >= end) {
+      break;
+    }
+
+    U8 c = *p;
+    if (c < 0x80) {
+      p++;
+      switch (c) {
+      case '"':
+        enc_mem(aTHX_ enc, "\\\"", 2);
+        break;
+      case '\\':
+        enc_mem(aTHX_ enc, "\\\\", 2);
+        break;
+      case '\b':
+        enc_mem(aTHX_ enc, "\\b", 2);
+        break;
+      case '\f':
+        enc_mem(aTHX_ enc, "\\f", 2);
+        break;
+      case '\n':
+        enc_mem(aTHX_ enc, "\\n", 2);
+        break;
+      case '\r':
+        enc_mem(aTHX_ enc, "\\r", 2);
+        break;
+      case '\t':
+        enc_mem(aTHX_ enc, "\\t", 2);
+        break;
+      default:
+        enc_uescape(aTHX_ enc, c);
+        break;
+      }
+    } else if (is_utf8) {
+      STRLEN clen;
+      UV cp = utf8n_to_uvchr(p, end - p, &clen, UTF8_CHECK_ONLY);
+      if (clen == (STRLEN)-1) {
+        croak("malformed UTF-8 character in JSON string");
+      }
+      // Already UTF-8, so copy the bytes when no escaping applies
+      if (!(enc->flags & (F_ASCII | F_LATIN1))) {
+        enc_mem(aTHX_ enc, (const char *)p, clen);
+      } else {
+        enc_char(aTHX_ enc, cp);
+      }
+      p += clen;
+    } else {
+      enc_char(aTHX_ enc, *p++);
+    }
+  }
+  enc_ch(aTHX_ enc, '"');
+}
+
+static void enc_sv(pTHX_ json_enc *enc, SV *sv);
+
+static void enc_key_sep(pTHX_ json_enc *enc) {
+  if (enc->flags & F_SPACE_BEFORE) {
+    enc_ch(aTHX_ enc, ' ');
+  }
+  enc_ch(aTHX_ enc, ':');
+  if (enc->flags & F_SPACE_AFTER) {
+    enc_ch(aTHX_ enc, ' ');
+  }
+}
+
+static void enc_depth(pTHX_ json_enc *enc) {
+  if (++enc->indent > enc->max_depth) {
+    croak(JSON_ERR_DEPTH);
+  }
+}
+
+static void enc_av(pTHX_ json_enc *enc, AV *av) {
+  SSize_t top = av_top_index(av);
+  if (top < 0) {
+    enc_mem(aTHX_ enc, "[]", 2);
+    return;
+  }
+  enc_depth(aTHX_ enc);
+  enc_ch(aTHX_ enc, '[');
+  for (SSize_t i = 0; i <= top; i++) {
+    if (i) {
+      enc_ch(aTHX_ enc, ',');
+    }
+    enc_newline(aTHX_ enc);
+    SV **svp = av_fetch(av, i, 0);
+    if (svp) {
+      enc_sv(aTHX_ enc, *svp);
+    } else {
+      enc_mem(aTHX_ enc, "null", 4);
+    }
+  }
+  enc->indent--;
+  enc_newline(aTHX_ enc);
+  enc_ch(aTHX_ enc, ']');
+}
+
+static void enc_hv(pTHX_ json_enc *enc, HV *hv) {
+  // A tied hash only knows whether it is empty once it is iterated
+  if (!SvRMAGICAL(hv) && !HvUSEDKEYS(hv)) {
+    enc_mem(aTHX_ enc, "{}", 2);
+    return;
+  }
+  hv_iterinit(hv);
+  enc_depth(aTHX_ enc);
+  enc_ch(aTHX_ enc, '{');
+
+  bool empty;
+  if (enc->flags & F_CANONICAL) {
+    // Sort the keys as strings, like JSON::PP's sort keys
+    SSize_t count = 0;
+    HE *he;
+    AV *keys = newAV();
+    sv_2mortal((SV *)keys);
+    while ((he = hv_iternext(hv))) {
+      SV *key = hv_iterkeysv(he);
+      av_push(keys, SvREFCNT_inc_simple_NN(key));
+    }
+    count = av_count(keys);
+    sortsv(AvARRAY(keys), count, Perl_sv_cmp);
+    for (SSize_t i = 0; i < count; i++) {
+      SV *key = AvARRAY(keys)[i];
+      STRLEN klen;
+      const char *k = SvPV(key, klen);
+      if (i) {
+        enc_ch(aTHX_ enc, ',');
+      }
+      enc_newline(aTHX_ enc);
+      enc_str(aTHX_ enc, k, klen, SvUTF8(key));
+      enc_key_sep(aTHX_ enc);
+      HE *val = hv_fetch_ent(hv, key, 0, 0);
+      enc_sv(aTHX_ enc, val ? HeVAL(val) : &PL_sv_undef);
+    }
+    empty = count == 0;
+  } else {
+    HE *he;
+    bool first = true;
+    while ((he = hv_iternext(hv))) {
+      if (!first) {
+        enc_ch(aTHX_ enc, ',');
+      }
+      first = false;
+      enc_newline(aTHX_ enc);
+      if (HeKLEN(he) == HEf_SVKEY) {
+        STRLEN klen;
+        const char *k = SvPV(HeSVKEY(he), klen);
+        enc_str(aTHX_ enc, k, klen, SvUTF8(HeSVKEY(he)));
+      } else {
+        enc_str(aTHX_ enc, HeKEY(he), HeKLEN(he), HeKUTF8(he));
+      }
+      enc_key_sep(aTHX_ enc);
+      enc_sv(aTHX_ enc, hv_iterval(hv, he));
+    }
+    empty = first;
+  }
+
+  enc->indent--;
+  if (!empty) {
+    enc_newline(aTHX_ enc);
+  }
+  enc_ch(aTHX_ enc, '}');
+}
+
+// The boolean classes JSON::PP::is_bool accepts
+static bool json_is_bool(pTHX_ SV *ref) {
+  return sv_derived_from(ref, "JSON::PP::Boolean") ||
+         sv_derived_from(ref, "Types::Serialiser::BooleanBase") ||
+         sv_derived_from(ref, "JSON::XS::Boolean");
+}
+
+static void enc_number(pTHX_ json_enc *enc, SV *sv) {
+  char tmp[64];
+  int len;
+  // NOK with a private-only IOK is a fraction that was used as an integer
+  if (SvIOK(sv) || !SvNOKp(sv)) {
+    if (SvIsUV(sv)) {
+      len = snprintf(tmp, sizeof tmp, "%" UVuf, SvUVX(sv));
+    } else {
+      len = snprintf(tmp, sizeof tmp, "%" IVdf, SvIVX(sv));
+    }
+    enc_mem(aTHX_ enc, tmp, len);
+    return;
+  }
+  NV nv = SvNVX(sv);
+  if (!Perl_isfinite(nv)) {
+    // Inf and NaN as Perl prints them, which is what JSON::PP writes too
+    STRLEN plen;
+    const char *p = SvPV(sv_2mortal(newSVnv(nv)), plen);
+    enc_mem(aTHX_ enc, p, plen);
+    return;
+  }
+  // The precision of Perl's own number stringification
+  len = snprintf(tmp, sizeof tmp, "%.*" NVgf, NV_DIG, nv);
+  enc_mem(aTHX_ enc, tmp, len);
+}
+
+static void enc_ref(pTHX_ json_enc *enc, SV *sv) {
+  SV *target = SvRV(sv);
+
+  if (SvOBJECT(target)) {
+    if (json_is_bool(aTHX_ sv)) {
+      if (SvTRUE(target)) {
+        enc_mem(aTHX_ enc, "true", 4);
+      } else {
+        enc_mem(aTHX_ enc, "false", 5);
+      }
+      return;
+    }
+    if (enc->flags & F_CONVERT_BLESSED) {
+      HV *stash = SvSTASH(target);
+      GV *to_json = gv_fetchmethod_autoload(stash, "TO_JSON", 0);
+      if (to_json) {
+        dSP;
+        ENTER;
+        SAVETMPS;
+        PUSHMARK(SP);
+        XPUSHs(sv_2mortal(newRV_inc(target)));
+        PUTBACK;
+        int count = call_sv((SV *)GvCV(to_json), G_SCALAR);
+        SPAGAIN;
+        if (count != 1) {
+          croak("%s::TO_JSON method did not return a single value",
+                HvNAME_get(stash));
+        }
+        SV *res = POPs;
+        PUTBACK;
+        if (SvROK(res) && SvRV(res) == target) {
+          croak("%s::TO_JSON method returned same object as was passed "
+                "instead of a new one",
+                HvNAME_get(stash));
+        }
+        enc_sv(aTHX_ enc, res);
+        FREETMPS;
+        LEAVE;
+        return;
+      }
+    }
+    if (enc->flags & F_ALLOW_BLESSED) {
+      enc_mem(aTHX_ enc, "null", 4);
+      return;
+    }
+    croak("encountered object '%" SVf "', but neither allow_blessed, "
+          "convert_blessed nor allow_tags settings are enabled (or "
+          "TO_JSON/FREEZE method missing)",
+          SVfARG(sv));
+  }
+
+  switch (SvTYPE(target)) {
+  case SVt_PVAV:
+    enc_av(aTHX_ enc, (AV *)target);
+    return;
+  case SVt_PVHV:
+    enc_hv(aTHX_ enc, (HV *)target);
+    return;
+  default:
+    break;
+  }
+
+  // \1 and \0 stand for true and false
+  if (SvTYPE(target) < SVt_PVAV && !SvROK(target) && SvOK(target)) {
+    STRLEN len;
+    const char *p = SvPV(target, len);
+    if (len == 1 && (*p == '1' || *p == '0')) {
+      if (*p == '1') {
+        enc_mem(aTHX_ enc, "true", 4);
+      } else {
+        enc_mem(aTHX_ enc, "false", 5);
+      }
+      return;
+    }
+  }
+
+  if (enc->flags & F_ALLOW_UNKNOWN) {
+    enc_mem(aTHX_ enc, "null", 4);
+    return;
+  }
+  if (SvTYPE(target) < SVt_PVAV) {
+    croak("cannot encode reference to scalar");
+  }
+  croak("encountered %" SVf ", but JSON can only represent references to "
+        "arrays or hashes",
+        SVfARG(sv));
+}
+
+static void enc_sv(pTHX_ json_enc *enc, SV *sv) {
+  SvGETMAGIC(sv);
+
+  if (SvROK(sv)) {
+    enc_ref(aTHX_ enc, sv);
+    return;
+  }
+#ifdef SvIsBOOL
+  if (SvIsBOOL(sv)) {
+    if (SvTRUE_nomg(sv)) {
+      enc_mem(aTHX_ enc, "true", 4);
+    } else {
+      enc_mem(aTHX_ enc, "false", 5);
+    }
+    return;
+  }
+#endif
+  // A number unless it was created as a string, as in JSON::PP. Since 5.36
+  // stringifying a number only sets the private POK flag.
+  if (SvPOK(sv)) {
+    enc_str(aTHX_ enc, SvPVX(sv), SvCUR(sv), SvUTF8(sv));
+    return;
+  }
+  if (SvIOKp(sv) || SvNOKp(sv)) {
+    enc_number(aTHX_ enc, sv);
+    return;
+  }
+  if (SvPOKp(sv)) {
+    enc_str(aTHX_ enc, SvPVX(sv), SvCUR(sv), SvUTF8(sv));
+    return;
+  }
+  if (!SvOK(sv)) {
+    enc_mem(aTHX_ enc, "null", 4);
+    return;
+  }
+  if (SvTYPE(sv) == SVt_PVGV && (enc->flags & F_ALLOW_UNKNOWN)) {
+    enc_mem(aTHX_ enc, "null", 4);
+    return;
+  }
+  // Anything else (globs, vstrings) goes through its string form
+  STRLEN len;
+  const char *p = SvPV_nomg(sv, len);
+  enc_str(aTHX_ enc, p, len, SvUTF8(sv));
+}
+
+static SV *json_encode(pTHX_ U32 flags, U32 max_depth, SV *data) {
+  json_enc enc;
+  enc.flags = flags;
+  enc.max_depth = max_depth;
+  enc.indent = 0;
+  enc.sv = sv_2mortal(newSV(64));
+  SvPOK_only(enc.sv);
+  enc.cur = SvPVX(enc.sv);
+  enc.end = enc.cur + SvLEN(enc.sv) - 1;
+
+  SvGETMAGIC(data);
+  if (!(flags & F_ALLOW_NONREF) && !SvROK(data)) {
+    croak("hash- or arrayref expected (not a simple scalar, use "
+          "allow_nonref to allow this)");
+  }
+
+  enc_sv(aTHX_ &enc, data);
+  if (flags & F_INDENT) {
+    enc_ch(aTHX_ &enc, '\n');
+  }
+
+  *enc.cur = '\0';
+  SvCUR_set(enc.sv, enc.cur - SvPVX(enc.sv));
+  // Bytes for utf8, Latin-1 or ASCII characters for latin1/ascii, and
+  // otherwise a character string
+  if (!(flags & (F_UTF8 | F_LATIN1 | F_ASCII)) &&
+      !is_utf8_invariant_string((U8 *)SvPVX(enc.sv), SvCUR(enc.sv))) {
+    SvUTF8_on(enc.sv);
+  }
+  return SvREFCNT_inc_simple_NN(enc.sv);
+}
+
+//
+// Decoder
+//
+
+static void dec_error(pTHX_ json_dec *dec,
+                      const char *msg) __attribute__noreturn__;
+
+static void dec_error(pTHX_ json_dec *dec, const char *msg) {
+  // Character offset, as JSON::PP reports it
+  STRLEN offset = dec->cur - dec->start;
+  if (!(dec->flags & F_UTF8)) {
+    offset = utf8_length((const U8 *)dec->start, (const U8 *)dec->cur);
+  }
+  if (dec->cur >= dec->end) {
+    croak("%s, at character offset %lu (before \"(end of string)\")", msg,
+          (unsigned long)offset);
+  }
+  STRLEN rest = dec->end - dec->cur;
+  if (rest > 20) {
+    rest = 20;
+  }
+  croak("%s, at character offset %lu (before \"%.*s\")", msg,
+        (unsigned long)offset, (int)rest, dec->cur);
+}
+
+static void dec_ws(json_dec *dec) {
+  for (;;) {
+    while (dec->cur < dec->end &&
+           (*dec->cur == ' ' || *dec->cur == '\n' || *dec->cur == '\r' ||
+            *dec->cur == '\t')) {
+      dec->cur++;
+    }
+    if ((dec->flags & F_RELAXED) && dec->cur < dec->end && *dec->cur == '#') {
+      while (dec->cur < dec->end && *dec->cur != '\n') {
+        dec->cur++;
+      }
+      continue;
+    }
+    return;
+  }
+}
+
+static SV *dec_value(pTHX_ json_dec *dec);
+
+static int dec_hex4(json_dec *dec, UV *out) {
+  if (dec->end - dec->cur < 4) {
+    return 0;
+  }
+  UV cp = 0;
+  for (int i = 0; i < 4; i++) {
+    char c = dec->cur[i];
+    cp <<= 4;
+    if (c >= '0' && c <= '9') {
+      cp |= c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      cp |= c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      cp |= c - 'A' + 10;
+    } else {
+      return 0;
+    }
+  }
+  dec->cur += 4;
+  *out = cp;
+  return 1;
+}
+
+// Decodes a string after its opening quote into a new UTF-8 SV
+static SV *dec_str(pTHX_ json_dec *dec) {
+  const char *p = dec->cur;
+  // Fast path: no escapes, so the string is a copy of the input
+  while (p < dec->end && *p != '"' && *p != '\\' && (U8)*p >= 0x20) {
+    p++;
+  }
+  SV *sv = sv_2mortal(newSVpvn(dec->cur, p - dec->cur));
+  dec->cur = p;
+
+  for (;;) {
+    if (dec->cur >= dec->end) {
+      dec_error(aTHX_ dec,
+                "unexpected end of string while parsing JSON string");
+    }
+    char c = *dec->cur;
+    if (c == '"') {
+      dec->cur++;
+      break;
+    }
+    if ((U8)c < 0x20) {
+      dec_error(aTHX_ dec,
+                "invalid character encountered while parsing JSON string");
+    }
+    if (c != '\\') {
+      p = dec->cur;
+      while (p < dec->end && *p != '"' && *p != '\\' && (U8)*p >= 0x20) {
+        p++;
+      }
+      sv_catpvn(sv, dec->cur, p - dec->cur);
+      dec->cur = p;
+      continue;
+    }
+
+    dec->cur++;
+    if (dec->cur >= dec->end) {
+      continue;
+    }
+    c = *dec->cur++;
+    switch (c) {
+    case '"':
+      sv_catpvn(sv, "\"", 1);
+      break;
+    case '\\':
+      sv_catpvn(sv, "\\", 1);
+      break;
+    case '/':
+      sv_catpvn(sv, "/", 1);
+      break;
+    case 'b':
+      sv_catpvn(sv, "\b", 1);
+      break;
+    case 'f':
+      sv_catpvn(sv, "\f", 1);
+      break;
+    case 'n':
+      sv_catpvn(sv, "\n", 1);
+      break;
+    case 'r':
+      sv_catpvn(sv, "\r", 1);
+      break;
+    case 't':
+      sv_catpvn(sv, "\t", 1);
+      break;
+    case 'u': {
+      UV cp;
+      if (!dec_hex4(dec, &cp)) {
+        dec_error(aTHX_ dec, "exactly four hexadecimal digits expected");
+      }
+      if (cp >= 0xd800 && cp <= 0xdbff) {
+        UV lo;
+        if (dec->end - dec->cur < 2 || dec->cur[0] != '\\' ||
+            dec->cur[1] != 'u') {
+          dec_error(aTHX_ dec,
+                    "missing low surrogate character in surrogate pair");
+        }
+        dec->cur += 2;
+        if (!dec_hex4(dec, &lo) || lo < 0xdc00 || lo > 0xdfff) {
+          dec_error(aTHX_ dec, "surrogate pair expected");
+        }
+        cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+      } else if (cp >= 0xdc00 && cp <= 0xdfff) {
+        dec_error(aTHX_ dec,
+                  "missing high surrogate character in surrogate pair");
+      }
+      U8 tmp[UTF8_MAXBYTES + 1];
+      U8 *e = uvchr_to_utf8(tmp, cp);
+      sv_catpvn(sv, (const char *)tmp, e - tmp);
+      break;
+    }
+    default:
+      dec->cur--;
+      dec_error(aTHX_ dec, "illegal backslash escape sequence in string");
+    }
+  }
+
+  if (!is_utf8_invariant_string((U8 *)SvPVX(sv), SvCUR(sv))) {
+    if (!is_utf8_string((U8 *)SvPVX(sv), SvCUR(sv))) {
+      dec_error(aTHX_ dec, "malformed UTF-8 character in JSON string");
+    }
+    SvUTF8_on(sv);
+  }
+  return SvREFCNT_inc_simple_NN(sv);
+}
+
+static SV *dec_number(pTHX_ json_dec *dec) {
+  const char *start = dec->cur;
+  bool is_float = false;
+
+  if (dec->cur < dec->end && *dec->cur == '-') {
+    dec->cur++;
+  }
+  if (dec->cur < dec->end && *dec->cur == '0') {
+    dec->cur++;
+    if (dec->cur < dec->end && isDIGIT(*dec->cur)) {
+      dec_error(aTHX_ dec, "malformed number (leading zero must not be "
+                           "followed by another digit)");
+    }
+  } else if (dec->cur < dec->end && isDIGIT(*dec->cur)) {
+    while (dec->cur < dec->end && isDIGIT(*dec->cur)) {
+      dec->cur++;
+    }
+  } else {
+    dec_error(aTHX_ dec, "malformed number (no digits after initial minus)");
+  }
+
+  if (dec->cur < dec->end && *dec->cur == '.') {
+    dec->cur++;
+    if (dec->cur >= dec->end || !isDIGIT(*dec->cur)) {
+      dec_error(aTHX_ dec, "malformed number (no digits after decimal point)");
+    }
+    while (dec->cur < dec->end && isDIGIT(*dec->cur)) {
+      dec->cur++;
+    }
+    is_float = true;
+  }
+  if (dec->cur < dec->end && (*dec->cur == 'e' || *dec->cur == 'E')) {
+    dec->cur++;
+    if (dec->cur < dec->end && (*dec->cur == '+' || *dec->cur == '-')) {
+      dec->cur++;
+    }
+    if (dec->cur >= dec->end || !isDIGIT(*dec->cur)) {
+      dec_error(aTHX_ dec, "malformed number (no digits after exp sign)");
+    }
+    while (dec->cur < dec->end && isDIGIT(*dec->cur)) {
+      dec->cur++;
+    }
+    is_float = true;
+  }
+
+  STRLEN len = dec->cur - start;
+  if (!is_float) {
+    UV uv;
+    const char *digits = *start == '-' ? start + 1 : start;
+    STRLEN dlen = len - (digits - start);
+    // grok_number handles the integer/overflow split like Perl's own
+    // numification
+    int type = grok_number(digits, dlen, &uv);
+    if ((type & (IS_NUMBER_IN_UV | IS_NUMBER_GREATER_THAN_UV_MAX)) ==
+        IS_NUMBER_IN_UV) {
+      if (*start != '-') {
+        return newSVuv(uv);
+      }
+      if (uv <= (UV)IV_MAX + 1) {
+        return newSViv(uv == (UV)IV_MAX + 1 ? IV_MIN : -(IV)uv);
+      }
+    }
+    // Too large for an integer: keep the digits, as JSON::PP does
+    return newSVpvn(start, len);
+  }
+
+  NV nv;
+  my_atof3(start, &nv, len);
+  return newSVnv(nv);
+}
+
+static void dec_depth(pTHX_ json_dec *dec) {
+  if (++dec->depth > dec->max_depth) {
+    dec_error(aTHX_ dec, JSON_ERR_DEPTH);
+  }
+}
+
+static SV *dec_av(pTHX_ json_dec *dec) {
+  AV *av = newAV();
+  SV *rv = sv_2mortal(newRV_noinc((SV *)av));
+  dec_depth(aTHX_ dec);
+  dec->cur++;
+  dec_ws(dec);
+  if (dec->cur < dec->end && *dec->cur == ']') {
+    dec->cur++;
+    dec->depth--;
+    return SvREFCNT_inc_simple_NN(rv);
+  }
+  for (;;) {
+    av_push(av, dec_value(aTHX_ dec));
+    dec_ws(dec);
+    if (dec->cur < dec->end && *dec->cur == ']') {
+      dec->cur++;
+      break;
+    }
+    if (dec->cur >= dec->end || *dec->cur != ',') {
+      dec_error(aTHX_ dec, ", or ] expected while parsing array");
+    }
+    dec->cur++;
+    dec_ws(dec);
+    if ((dec->flags & F_RELAXED) && dec->cur < dec->end && *dec->cur == ']') {
+      dec->cur++;
+      break;
+    }
+  }
+  dec->depth--;
+  return SvREFCNT_inc_simple_NN(rv);
+}
+
+static SV *dec_hv(pTHX_ json_dec *dec) {
+  HV *hv = newHV();
+  SV *rv = sv_2mortal(newRV_noinc((SV *)hv));
+  dec_depth(aTHX_ dec);
+  dec->cur++;
+  dec_ws(dec);
+  if (dec->cur < dec->end && *dec->cur == '}') {
+    dec->cur++;
+    dec->depth--;
+    return SvREFCNT_inc_simple_NN(rv);
+  }
+  for (;;) {
+    if (dec->cur >= dec->end || *dec->cur != '"') {
+      dec_error(aTHX_ dec, "'\"' expected while parsing object/hash");
+    }
+    dec->cur++;
+    SV *key = sv_2mortal(dec_str(aTHX_ dec));
+    dec_ws(dec);
+    if (dec->cur >= dec->end || *dec->cur != ':') {
+      dec_error(aTHX_ dec, "':' expected");
+    }
+    dec->cur++;
+    SV *val = dec_value(aTHX_ dec);
+    I32 klen = SvUTF8(key) ? -(I32)SvCUR(key) : (I32)SvCUR(key);
+    (void)hv_store(hv, SvPVX(key), klen, val, 0);
+    dec_ws(dec);
+    if (dec->cur < dec->end && *dec->cur == '}') {
+      dec->cur++;
+      break;
+    }
+    if (dec->cur >= dec->end || *dec->cur != ',') {
+      dec_error(aTHX_ dec, ", or } expected while parsing object/hash");
+    }
+    dec->cur++;
+    dec_ws(dec);
+    if ((dec->flags & F_RELAXED) && dec->cur < dec->end && *dec->cur == '}') {
+      dec->cur++;
+      break;
+    }
+  }
+  dec->depth--;
+  return SvREFCNT_inc_simple_NN(rv);
+}
+
+static SV *dec_literal(pTHX_ json_dec *dec, const char *word, STRLEN len,
+                       const char *var) {
+  if ((STRLEN)(dec->end - dec->cur) < len || memNE(dec->cur, word, len)) {
+    dec_error(aTHX_ dec, JSON_ERR_VALUE);
+  }
+  dec->cur += len;
+  if (!var) {
+    return newSV(0);
+  }
+  // The shared $ZeroPerl::JSON::true/false objects, as JSON::PP returns its
+  // own
+  return newSVsv(get_sv(var, GV_ADD));
+}
+
+static SV *dec_value(pTHX_ json_dec *dec) {
+  dec_ws(dec);
+  if (dec->cur >= dec->end) {
+    dec_error(aTHX_ dec, JSON_ERR_VALUE);
+  }
+  switch (*dec->cur) {
+  case '"':
+    dec->cur++;
+    return dec_str(aTHX_ dec);
+  case '[':
+    return dec_av(aTHX_ dec);
+  case '{':
+    return dec_hv(aTHX_ dec);
+  case 't':
+    return dec_literal(aTHX_ dec, "true", 4, "ZeroPerl::JSON::true");
+  case 'f':
+    return dec_literal(aTHX_ dec, "false", 5, "ZeroPerl::JSON::false");
+  case 'n':
+    return dec_literal(aTHX_ dec, "null", 4, NULL);
+  default:
+    if (*dec->cur == '-' || isDIGIT(*dec->cur)) {
+      return dec_number(aTHX_ dec);
+    }
+    dec_error(aTHX_ dec, JSON_ERR_VALUE);
+  }
+  return NULL;
+}
+
+static SV *json_decode(pTHX_ U32 flags, U32 max_depth, SV *text) {
+  json_dec dec;
+  STRLEN len;
+
+  SvGETMAGIC(text);
+  if (!SvOK(text)) {
+    croak(JSON_ERR_VALUE
+          ", at character offset 0 (before \"(end of string)\")");
+  }
+
+  // The parser works on UTF-8: bytes as given for utf8, characters upgraded
+  // otherwise
+  if (flags & F_UTF8) {
+    if (SvUTF8(text)) {
+      text = sv_2mortal(newSVsv_nomg(text));
+      if (!sv_utf8_downgrade(text, TRUE)) {
+        croak("Wide character in subroutine entry");
+      }
+    }
+  } else if (!SvUTF8(text)) {
+    text = sv_2mortal(newSVsv_nomg(text));
+    sv_utf8_upgrade(text);
+  }
+
+  dec.start = SvPV_nomg(text, len);
+  dec.cur = dec.start;
+  dec.end = dec.start + len;
+  dec.flags = flags;
+  dec.max_depth = max_depth;
+  dec.depth = 0;
+
+  dec_ws(&dec);
+  if (!(flags & F_ALLOW_NONREF) &&
+      (dec.cur >= dec.end || (*dec.cur != '[' && *dec.cur != '{'))) {
+    dec_error(aTHX_ &dec,
+              "JSON text must be an object or array (but found number, "
+              "string, true, false or null, use allow_nonref to allow this)");
+  }
+
+  SV *sv = sv_2mortal(dec_value(aTHX_ &dec));
+  dec_ws(&dec);
+  if (dec.cur != dec.end) {
+    dec_error(aTHX_ &dec, "garbage after JSON object");
+  }
+  return SvREFCNT_inc_simple_NN(sv);
+}
+
+// Options of a ZeroPerl::JSON object
+static void json_self(pTHX_ SV *self, U32 *flags, U32 *max_depth) {
+  if (!SvROK(self) || SvTYPE(SvRV(self)) != SVt_PVHV) {
+    croak("object is not of type ZeroPerl::JSON");
+  }
+  HV *hv = (HV *)SvRV(self);
+  SV **svp = hv_fetchs(hv, "flags", 0);
+  *flags = svp ? (U32)SvUV(*svp) : F_DEFAULT;
+  svp = hv_fetchs(hv, "max_depth", 0);
+  *max_depth = svp ? (U32)SvUV(*svp) : JSON_MAX_DEPTH;
+}
+
+MODULE = ZeroPerl::JSON    PACKAGE = ZeroPerl::JSON
+
+PROTOTYPES: DISABLE
+
+BOOT:
+{
+  HV *flags = get_hv("ZeroPerl::JSON::FLAGS", GV_ADD);
+  for (size_t i = 0; i < sizeof json_flags / sizeof json_flags[0]; i++) {
+    const char *name = json_flags[i].name;
+    (void)hv_store(flags, name, strlen(name), newSVuv(json_flags[i].bit), 0);
+  }
+  sv_setuv(get_sv("ZeroPerl::JSON::DEFAULT_FLAGS", GV_ADD), F_DEFAULT);
+  sv_setuv(get_sv("ZeroPerl::JSON::DEFAULT_MAX_DEPTH", GV_ADD),
+           JSON_MAX_DEPTH);
+}
+
+SV *
+encode(SV *self, SV *data)
+  CODE:
+  {
+    U32 flags, max_depth;
+    json_self(aTHX_ self, &flags, &max_depth);
+    RETVAL = json_encode(aTHX_ flags, max_depth, data);
+  }
+  OUTPUT:
+    RETVAL
+
+SV *
+decode(SV *self, SV *text)
+  CODE:
+  {
+    U32 flags, max_depth;
+    json_self(aTHX_ self, &flags, &max_depth);
+    RETVAL = json_decode(aTHX_ flags, max_depth, text);
+  }
+  OUTPUT:
+    RETVAL
+
+SV *
+encode_json(SV *data)
+  PROTOTYPE: $
+  CODE:
+    RETVAL = json_encode(aTHX_ F_DEFAULT | F_UTF8, JSON_MAX_DEPTH, data);
+  OUTPUT:
+    RETVAL
+
+SV *
+decode_json(SV *text)
+  CODE:
+    RETVAL = json_decode(aTHX_ F_DEFAULT | F_UTF8, JSON_MAX_DEPTH, text);
+  OUTPUT:
+    RETVAL
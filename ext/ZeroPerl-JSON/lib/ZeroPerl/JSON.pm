@@ -0,0 +1,106 @@
+package ZeroPerl::JSON;
+
+use strict;
+use warnings;
+use Exporter qw(import);
+use JSON::PP::Boolean;
+use Scalar::Util ();
+
+our $VERSION = '1.00';
+
+our @EXPORT = qw(encode_json decode_json);
+our @EXPORT_OK = qw(encode_json decode_json);
+
+our (%FLAGS, $DEFAULT_FLAGS, $DEFAULT_MAX_DEPTH);
+
+require XSLoader;
+XSLoader::load('ZeroPerl::JSON', $VERSION);
+
+# Shared with JSON::PP when it is loaded, so both decode to the same objects
+our $true  = defined $JSON::PP::true  ? $JSON::PP::true  : do { bless \(my $dummy = 1), 'JSON::PP::Boolean' };
+our $false = defined $JSON::PP::false ? $JSON::PP::false : do { bless \(my $dummy = 0), 'JSON::PP::Boolean' };
+
+sub new {
+    my ($class) = @_;
+    return bless { flags => $DEFAULT_FLAGS, max_depth => $DEFAULT_MAX_DEPTH }, $class;
+}
+
+# Option setters and getters, one pair per bit of %FLAGS (see JSON.xs)
+for my $name (keys %FLAGS) {
+    my $bit = $FLAGS{$name};
+    no strict 'refs';
+    *{$name} = sub {
+        my $self = shift;
+        my $enable = @_ ? shift : 1;
+        if ($enable) { $self->{flags} |= $bit } else { $self->{flags} &= ~$bit }
+        return $self;
+    };
+    *{"get_$name"} = sub { $_[0]{flags} & $bit ? 1 : '' };
+}
+
+sub pretty {
+    my $self = shift;
+    my $enable = @_ ? shift : 1;
+    $self->$_($enable) for qw(indent space_before space_after);
+    return $self;
+}
+
+sub max_depth {
+    my $self = shift;
+    $self->{max_depth} = @_ ? shift : 0x80000000;
+    return $self;
+}
+
+sub get_max_depth { $_[0]{max_depth} }
+
+sub true  { $true }
+sub false { $false }
+sub null  { undef }
+
+sub is_bool {
+    Scalar::Util::blessed($_[0])
+        and ($_[0]->isa('JSON::PP::Boolean')
+            or $_[0]->isa('Types::Serialiser::BooleanBase')
+            or $_[0]->isa('JSON::XS::Boolean'));
+}
+
+1;
+
+__END__
+
+=head1 NAME
+
+ZeroPerl::JSON - JSON encoder and decoder in C for zeroperl
+
+=head1 SYNOPSIS
+
+    use ZeroPerl::JSON;
+
+    my $bytes = encode_json({ name => 'zeroperl', tags => [1, 2] });
+    my $data  = decode_json($bytes);
+
+    my $json = ZeroPerl::JSON->new->utf8->canonical->pretty;
+    print $json->encode($data);
+
+=head1 DESCRIPTION
+
+A C implementation of the commonly used part of the L<JSON::PP> interface,
+linked statically into zeroperl. Code written against JSON::PP works
+unchanged by replacing the class name.
+
+Decoded C<true> and C<false> are C<JSON::PP::Boolean> objects (the same ones
+as C<$JSON::PP::true> and C<$JSON::PP::false> when JSON::PP is loaded first),
+and the encoder accepts them, C<\1> and C<\0>, and Perl's native booleans.
+A scalar is encoded as a number only if it was never used as a string.
+
+=head1 OPTIONS
+
+C<ascii>, C<latin1>, C<utf8>, C<indent>, C<space_before>, C<space_after>,
+C<pretty>, C<canonical>, C<allow_nonref> (on by default, as in JSON::PP 4),
+C<allow_blessed>, C<convert_blessed>, C<allow_unknown>, C<relaxed> and
+C<max_depth>, each with a C<get_> accessor, behave as in JSON::PP.
+
+Incremental parsing, C<allow_bignum>, C<allow_tags>, C<boolean_values> and
+the filter callbacks are not provided.
+
+=cut
@@ -8,6 +8,7 @@ WASM_DIR="${WASM_DIR:-/build/wasm}"
 NATIVE_DIR="${NATIVE_DIR:-/build/native}"
 REPO_DIR="${REPO_DIR:-/build/repo}"
 NPROC="${NPROC:-$(nproc)}"
+SETJMP="${SETJMP:-asyncify}"
 
 export PATH="$REPO_DIR/wasi-bin:$PATH"
 
@@ -16,11 +17,21 @@ curl -fsSL "$URLPERL" | tar -xzf - --strip-components=1 --directory="$WASM_DIR"
 
 WASI_VERSION=$(cat "$WASI_SDK_PATH/VERSION" 2>/dev/null | tr -d '\n' || echo "unknown")
 
+# libperl's setjmp/longjmp backend, see build-wasm.sh
+case "$SETJMP" in
+    asyncify) SETJMP_CFLAGS=""; SETJMP_LIBS="" ;;
+    eh) SETJMP_CFLAGS="-DWASM_SETJMP_EH -mllvm -wasm-enable-sjlj -mllvm -wasm-use-legacy-eh=false"; SETJMP_LIBS="-lsetjmp" ;;
+    eh-legacy) SETJMP_CFLAGS="-DWASM_SETJMP_EH -mllvm -wasm-enable-sjlj"; SETJMP_LIBS="-lsetjmp" ;;
+    *) echo "Unknown SETJMP mode: $SETJMP (expected asyncify, eh or eh-legacy)" >&2; exit 1 ;;
+esac
+
 # Generate hints with path substitutions
 sed -e "s|__STUBS_DIR__|$REPO_DIR/stubs|g" \
     -e "s|__WASI_SDK_PATH__|$WASI_SDK_PATH|g" \
     -e "s|__NATIVE_DIR__|$NATIVE_DIR|g" \
     -e "s|__WASI_SDK_VERSION__|wasi-sdk-$WASI_VERSION|g" \
+    -e "s|__SETJMP_CFLAGS__|$SETJMP_CFLAGS|g" \
+    -e "s|__SETJMP_LIBS__|$SETJMP_LIBS|g" \
     "$REPO_DIR/pipeline/hints-wasi.sh" > "$WASM_DIR/hints/wasi.sh"
 
 cd "$WASM_DIR"
@@ -30,6 +41,15 @@ chmod u+w ./ext/File-Glob/bsd_glob.c
 patch -p1 < "$REPO_DIR/patches/glob.patch"
 chmod u-w ./ext/File-Glob/bsd_glob.c
 
+# JMPENV_RUN and docatch() on asyncjmp's try/catch loop (inert unless
+# ASYNCJMP_TRY_CATCH, i.e. SETJMP=asyncify)
+chmod u+w ./cop.h ./pp_ctl.c
+patch -p1 < "$REPO_DIR/patches/jmpenv.patch"
+chmod u-w ./cop.h ./pp_ctl.c
+
+# zeroperl's own extensions, built with the core ones (static_ext in hints-wasi.sh)
+cp -R "$REPO_DIR/ext/"* ./ext/
+
 # Configure
 wasiconfigure sh ./Configure -sde -Dhintfile=wasi
 
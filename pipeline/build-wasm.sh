@@ -7,17 +7,74 @@ REPO_DIR="${REPO_DIR:-/build/repo}"
 STACK_SIZE="${STACK_SIZE:-8388608}"
 INITIAL_MEMORY="${INITIAL_MEMORY:-33554432}"
 ASYNCIFY="${ASYNCIFY:-true}"
+SETJMP="${SETJMP:-asyncify}"
+ASYNCIFY_PROFILE="${ASYNCIFY_PROFILE:-false}"
+SIMD="${SIMD:-true}"
 
 export PATH="$REPO_DIR/wasi-bin:$PATH"
 
-cd "$REPO_DIR/stubs"
-wasic -flto -O3 -c machine.c -o machine.o
-wasic -flto -O3 -c runtime.c -o runtime.o
-wasic -flto -O3 -c setjmp.c -o setjmp.o
-wasic -flto -O3 -c machine_core.S -o machine_core.o
-wasic -flto -O3 -c setjmp_core.S -o setjmp_core.o
-"${WASI_SDK_PATH}/bin/llvm-ar" crs libasyncjmp.a \
-    machine.o runtime.o setjmp.o machine_core.o setjmp_core.o
+# setjmp/longjmp backend; must match the one libperl was built with
+# (build-wasi-perl.sh). The eh modes lower setjmp onto Wasm exception
+# handling and drop Asyncify entirely, so ASYNCIFY does not apply to them.
+case "$SETJMP" in
+    asyncify)
+        SETJMP_CFLAGS=""
+        SETJMP_LDFLAGS=""
+        ;;
+    eh)
+        SETJMP_CFLAGS="-DWASM_SETJMP_EH -mllvm -wasm-enable-sjlj -mllvm -wasm-use-legacy-eh=false"
+        SETJMP_LDFLAGS="-Wl,-mllvm,-wasm-enable-sjlj -Wl,-mllvm,-wasm-use-legacy-eh=false -lsetjmp"
+        ;;
+    eh-legacy)
+        SETJMP_CFLAGS="-DWASM_SETJMP_EH -mllvm -wasm-enable-sjlj"
+        SETJMP_LDFLAGS="-Wl,-mllvm,-wasm-enable-sjlj -lsetjmp"
+        ;;
+    *)
+        echo "Unknown SETJMP mode: $SETJMP (expected asyncify, eh or eh-legacy)" >&2
+        exit 1
+        ;;
+esac
+
+# Profile-guided Asyncify: instrument only the functions seen on the stack
+# during unwinds while tools/profile runs (see tools/asyncify-profile.js).
+# The profiled module is the shipped one: -DASYNCJMP_PROFILE builds in an
+# unwind report that stays off unless the profiler turns it on, so the
+# recorded names come from the same objects and LTO decisions.
+if [ "$SETJMP" != "asyncify" ] || [ "$ASYNCIFY" != "true" ]; then
+    ASYNCIFY_PROFILE=false
+fi
+PROFILE_CFLAGS=""
+if [ "$ASYNCIFY_PROFILE" = "true" ]; then
+    PROFILE_CFLAGS="-DASYNCJMP_PROFILE"
+fi
+
+# Wasm SIMD128 for the string validation and transcoding in zeroperl.c; the
+# scalar fallback is used when off, for hosts without SIMD support
+if [ "$SIMD" = "true" ]; then
+    SIMD_CFLAGS="-msimd128"
+    SIMD_FEATURES="--enable-simd"
+else
+    SIMD_CFLAGS=""
+    SIMD_FEATURES=""
+fi
+
+# build_asyncjmp <archive> [cflags]
+build_asyncjmp() {
+    archive="$1"
+    shift
+    objdir="$REPO_DIR/stubs/${archive%.a}"
+    mkdir -p "$objdir"
+    for src in machine.c runtime.c setjmp.c machine_core.S setjmp_core.S; do
+        wasic -flto -O3 "$@" -c "$REPO_DIR/stubs/$src" -o "$objdir/${src%.*}.o"
+    done
+    rm -f "$REPO_DIR/stubs/$archive"
+    "${WASI_SDK_PATH}/bin/llvm-ar" crs "$REPO_DIR/stubs/$archive" "$objdir"/*.o
+}
+
+if [ "$SETJMP" = "asyncify" ]; then
+    build_asyncjmp libasyncjmp.a $PROFILE_CFLAGS
+    SETJMP_LDFLAGS="-Wl,--whole-archive $REPO_DIR/stubs/libasyncjmp.a -Wl,--no-whole-archive"
+fi
 
 cd "$WASM_DIR"
 cp "$REPO_DIR/stubs/zeroperl.c" .
@@ -27,9 +84,15 @@ CFLAGS="-c -O3 -flto -DNO_MATHOMS -D_WASI_EMULATED_PROCESS_CLOCKS -D_WASI_EMULAT
 -Wno-null-pointer-arithmetic -Wno-incomplete-setjmp-declaration -Wno-incompatible-library-redeclaration \
 -Wno-int-conversion -D_WASI_EMULATED_SIGNAL \
 -include /opt/wasi-sdk/share/wasi-sysroot/include/wasm32-wasi/fcntl.h \
--I. -I$REPO_DIR/stubs -I$REPO_DIR/gen -cxx-isystem /opt/wasi-sdk/share/wasi-sysroot/include"
+-I. -I$REPO_DIR/stubs -I$REPO_DIR/gen -cxx-isystem /opt/wasi-sdk/share/wasi-sysroot/include \
+$SETJMP_CFLAGS"
+
+# Compressed SFS entries are inflated with the zlib bundled into
+# Compress::Raw::Zlib; build against its headers with the same defines so the
+# symbol names match the objects in Zlib.a
+ZLIB_CFLAGS="-I$WASM_DIR/cpan/Compress-Raw-Zlib/zlib-src -DNO_VIZ -DZ_SOLO -DPerl_crz_BUILD_ZLIB"
 
-wasic $CFLAGS zeroperl.c -o zeroperl.o
+wasic $CFLAGS $ZLIB_CFLAGS $SIMD_CFLAGS $PROFILE_CFLAGS zeroperl.c -o zeroperl.o
 wasic $CFLAGS "$REPO_DIR/stubs/stubs.c" -o stubs.o
 wasic $CFLAGS "$REPO_DIR/stubs/async_web_api.c" -o async_web_api.o
 
@@ -37,83 +100,133 @@ CFLAGS_DATA="-c -O0 -std=c23 \
 -I. -I$REPO_DIR/stubs -I$REPO_DIR/gen -cxx-isystem /opt/wasi-sdk/share/wasi-sysroot/include"
 wasic $CFLAGS_DATA "$REPO_DIR/gen/zeroperl_data.c" -o zeroperl_data.o
 
-wasic \
-    -o zeroperl_reactor.wasm \
-    -flto -g \
-    -mexec-model=reactor \
-    -z stack-size="$STACK_SIZE" -Wl,--initial-memory="$INITIAL_MEMORY" \
-    -static \
-    -Wl,--no-entry \
-    -Wl,--stack-first \
-    -Wl,--export-dynamic \
-    -Wl,--export=__stack_pointer \
-    -Wl,--export=__memory_base \
-    -Wl,--export=__table_base \
-    -Wl,--export=malloc \
-    -Wl,--export=free \
-    -DNO_MATHOMS \
-    -D_WASI_EMULATED_PROCESS_CLOCKS -lwasi-emulated-process-clocks \
-    -D_WASI_EMULATED_GETPID -lwasi-emulated-getpid \
-    -D_GNU_SOURCE -D_POSIX_C_SOURCE \
-    -DBIG_TIME \
-    -D_WASI_EMULATED_SIGNAL -lwasi-emulated-signal \
-    -lwasi-emulated-mman \
-    -Wl,--strip-all \
-    -Wl,--allow-undefined \
-    zeroperl.o stubs.o async_web_api.o zeroperl_data.o
-    -Wl,--whole-archive "$REPO_DIR/stubs/libasyncjmp.a" -Wl,--no-whole-archive \
-    -Wl,--whole-archive libperl.a -Wl,--no-whole-archive \
-    -Wl,--wrap=fopen -Wl,--wrap=open -Wl,--wrap=close -Wl,--wrap=read \
-    -Wl,--wrap=lseek -Wl,--wrap=stat -Wl,--wrap=fstat \
-    lib/auto/File/Glob/Glob.a \
-    lib/auto/Sys/Hostname/Hostname.a \
-    lib/auto/PerlIO/via/via.a \
-    lib/auto/PerlIO/mmap/mmap.a \
-    lib/auto/PerlIO/encoding/encoding.a \
-    lib/auto/attributes/attributes.a \
-    lib/auto/Unicode/Normalize/Normalize.a \
-    lib/auto/Unicode/Collate/Collate.a \
-    lib/auto/re/re.a \
-    lib/auto/Digest/MD5/MD5.a \
-    lib/auto/Digest/SHA/SHA.a \
-    lib/auto/Math/BigInt/FastCalc/FastCalc.a \
-    lib/auto/Data/Dumper/Dumper.a \
-    lib/auto/I18N/Langinfo/Langinfo.a \
-    lib/auto/Time/Piece/Piece.a \
-    lib/auto/IO/IO.a \
-    lib/auto/Hash/Util/FieldHash/FieldHash.a \
-    lib/auto/Hash/Util/Util.a \
-    lib/auto/Filter/Util/Call/Call.a \
-    lib/auto/Encode/Unicode/Unicode.a \
-    lib/auto/Encode/Encode.a \
-    lib/auto/Encode/JP/JP.a \
-    lib/auto/Encode/KR/KR.a \
-    lib/auto/Encode/EBCDIC/EBCDIC.a \
-    lib/auto/Encode/CN/CN.a \
-    lib/auto/Encode/Symbol/Symbol.a \
-    lib/auto/Encode/Byte/Byte.a \
-    lib/auto/Encode/TW/TW.a \
-    lib/auto/Compress/Raw/Zlib/Zlib.a \
-    lib/auto/Compress/Raw/Bzip2/Bzip2.a \
-    lib/auto/MIME/Base64/Base64.a \
-    lib/auto/Cwd/Cwd.a \
-    lib/auto/List/Util/Util.a \
-    lib/auto/Fcntl/Fcntl.a \
-    lib/auto/Opcode/Opcode.a \
-    lib/auto/Time/HiRes/HiRes.a \
-    $(cat ext.libs) \
-    -lm -lwasi-emulated-signal -lwasi-emulated-getpid \
-    -lwasi-emulated-process-clocks -lwasi-emulated-mman \
-    -ferror-limit=0
-
-if [ "$ASYNCIFY" = "true" ]; then
+# Profiling needs function names to build the Asyncify lists, so the link
+# keeps them and the final wasm-opt run drops them instead
+STRIP_LDFLAGS="-Wl,--strip-all"
+if [ "$ASYNCIFY_PROFILE" = "true" ]; then
+    STRIP_LDFLAGS=""
+fi
+
+# link_reactor <output> <zeroperl object> <setjmp ldflags>
+link_reactor() {
+    wasic \
+        -o "$1" \
+        -flto -g \
+        -mexec-model=reactor \
+        -z stack-size="$STACK_SIZE" -Wl,--initial-memory="$INITIAL_MEMORY" \
+        -static \
+        -Wl,--no-entry \
+        -Wl,--stack-first \
+        -Wl,--export-dynamic \
+        -Wl,--export=__stack_pointer \
+        -Wl,--export=__memory_base \
+        -Wl,--export=__table_base \
+        -Wl,--export=malloc \
+        -Wl,--export=free \
+        -DNO_MATHOMS \
+        -D_WASI_EMULATED_PROCESS_CLOCKS -lwasi-emulated-process-clocks \
+        -D_WASI_EMULATED_GETPID -lwasi-emulated-getpid \
+        -D_GNU_SOURCE -D_POSIX_C_SOURCE \
+        -DBIG_TIME \
+        -D_WASI_EMULATED_SIGNAL -lwasi-emulated-signal \
+        -lwasi-emulated-mman \
+        $STRIP_LDFLAGS \
+        -Wl,--allow-undefined \
+        "$2" stubs.o async_web_api.o zeroperl_data.o \
+        $3 \
+        -Wl,--whole-archive libperl.a -Wl,--no-whole-archive \
+        -Wl,--wrap=fopen -Wl,--wrap=fclose -Wl,--wrap=fileno \
+        -Wl,--wrap=open -Wl,--wrap=close -Wl,--wrap=read \
+        -Wl,--wrap=lseek -Wl,--wrap=stat -Wl,--wrap=lstat -Wl,--wrap=fstat \
+        -Wl,--wrap=access \
+        -Wl,--wrap=opendir -Wl,--wrap=readdir -Wl,--wrap=rewinddir \
+        -Wl,--wrap=closedir -Wl,--wrap=telldir -Wl,--wrap=seekdir \
+        -Wl,--wrap=dirfd \
+        lib/auto/File/Glob/Glob.a \
+        lib/auto/Sys/Hostname/Hostname.a \
+        lib/auto/PerlIO/via/via.a \
+        lib/auto/PerlIO/mmap/mmap.a \
+        lib/auto/PerlIO/encoding/encoding.a \
+        lib/auto/attributes/attributes.a \
+        lib/auto/Unicode/Normalize/Normalize.a \
+        lib/auto/Unicode/Collate/Collate.a \
+        lib/auto/re/re.a \
+        lib/auto/Digest/MD5/MD5.a \
+        lib/auto/Digest/SHA/SHA.a \
+        lib/auto/Math/BigInt/FastCalc/FastCalc.a \
+        lib/auto/Data/Dumper/Dumper.a \
+        lib/auto/I18N/Langinfo/Langinfo.a \
+        lib/auto/Time/Piece/Piece.a \
+        lib/auto/IO/IO.a \
+        lib/auto/Hash/Util/FieldHash/FieldHash.a \
+        lib/auto/Hash/Util/Util.a \
+        lib/auto/Filter/Util/Call/Call.a \
+        lib/auto/Encode/Unicode/Unicode.a \
+        lib/auto/Encode/Encode.a \
+        lib/auto/Encode/JP/JP.a \
+        lib/auto/Encode/KR/KR.a \
+        lib/auto/Encode/EBCDIC/EBCDIC.a \
+        lib/auto/Encode/CN/CN.a \
+        lib/auto/Encode/Symbol/Symbol.a \
+        lib/auto/Encode/Byte/Byte.a \
+        lib/auto/Encode/TW/TW.a \
+        lib/auto/Compress/Raw/Zlib/Zlib.a \
+        lib/auto/Compress/Raw/Bzip2/Bzip2.a \
+        lib/auto/MIME/Base64/Base64.a \
+        lib/auto/Cwd/Cwd.a \
+        lib/auto/List/Util/Util.a \
+        lib/auto/Fcntl/Fcntl.a \
+        lib/auto/Opcode/Opcode.a \
+        lib/auto/Time/HiRes/HiRes.a \
+        lib/auto/ZeroPerl/JSON/JSON.a \
+        $(cat ext.libs) \
+        -lm -lwasi-emulated-signal -lwasi-emulated-getpid \
+        -lwasi-emulated-process-clocks -lwasi-emulated-mman \
+        -ferror-limit=0
+}
+
+link_reactor zeroperl_reactor.wasm zeroperl.o "$SETJMP_LDFLAGS"
+
+if [ "$SETJMP" != "asyncify" ]; then
+    wasm-opt zeroperl_reactor.wasm -O3 -g --strip-dwarf --enable-bulk-memory \
+        --enable-nontrapping-float-to-int $SIMD_FEATURES --enable-exception-handling \
+        -o zeroperl.wasm
+elif [ "$ASYNCIFY_PROFILE" = "true" ]; then
+    ASYNCIFY_IMPORTS="asyncify-imports@wasi_snapshot_preview1.fd_read,env.call_host_function,env.call_host_function_typed,env.js_async_fetch,env.js_async_timer,env.js_async_resolve_pending"
+
+    # The shipped reactor, fully instrumented and with names kept, run over
+    # the workloads to record which functions are on the stack at an unwind
+    wasm-opt zeroperl_reactor.wasm -O3 -g --strip-dwarf --enable-bulk-memory \
+        --enable-nontrapping-float-to-int $SIMD_FEATURES --asyncify \
+        --pass-arg="$ASYNCIFY_IMPORTS" \
+        -o zeroperl_profile.wasm
+    node "$REPO_DIR/tools/asyncify-profile.js" record \
+        -i zeroperl_profile.wasm -w "$REPO_DIR/tools/profile" -o asyncify-onlylist.txt
+
+    # Fully instrumented baseline, only built to compare against
+    wasm-opt zeroperl_reactor.wasm -O3 --strip-debug --enable-bulk-memory \
+        --enable-nontrapping-float-to-int $SIMD_FEATURES --asyncify \
+        --pass-arg="$ASYNCIFY_IMPORTS" \
+        -o zeroperl_full.wasm
+    wasm-opt zeroperl_reactor.wasm -O3 --strip-debug --enable-bulk-memory \
+        --enable-nontrapping-float-to-int $SIMD_FEATURES --asyncify \
+        --pass-arg="$ASYNCIFY_IMPORTS" \
+        --pass-arg=asyncify-onlylist@@asyncify-onlylist.txt \
+        -o zeroperl.wasm
+    node "$REPO_DIR/tools/asyncify-profile.js" compare \
+        -w "$REPO_DIR/tools/profile" zeroperl_full.wasm zeroperl.wasm
+
+    wasm-opt zeroperl_reactor.wasm --strip-debug --enable-bulk-memory \
+        --enable-nontrapping-float-to-int $SIMD_FEATURES -o zeroperl_reactor.wasm
+    rm -f zeroperl_profile.wasm zeroperl_full.wasm
+elif [ "$ASYNCIFY" = "true" ]; then
     wasm-opt zeroperl_reactor.wasm -O3 -g --strip-dwarf --enable-bulk-memory \
-        --enable-nontrapping-float-to-int --asyncify \
-        --pass-arg=asyncify-imports@wasi_snapshot_preview1.fd_read,env.call_host_function,env.js_async_fetch,env.js_async_timer,env.js_async_resolve_pending
+        --enable-nontrapping-float-to-int $SIMD_FEATURES --asyncify \
+        --pass-arg=asyncify-imports@wasi_snapshot_preview1.fd_read,env.call_host_function,env.call_host_function_typed,env.js_async_fetch,env.js_async_timer,env.js_async_resolve_pending \
         -o zeroperl.wasm
 else
     wasm-opt zeroperl_reactor.wasm -g --strip-dwarf --enable-bulk-memory \
-        --enable-nontrapping-float-to-int --asyncify \
+        --enable-nontrapping-float-to-int $SIMD_FEATURES --asyncify \
         --pass-arg=asyncify-ignore-imports \
         -o zeroperl.wasm
 fi
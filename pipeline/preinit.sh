@@ -0,0 +1,18 @@
+#!/bin/sh
+set -e
+
+WASM_DIR="${WASM_DIR:-/build/wasm}"
+REPO_DIR="${REPO_DIR:-/build/repo}"
+PREINIT="${PREINIT:-false}"
+PRELOAD="${PRELOAD:-}"
+
+if [ "$PREINIT" != "true" ]; then
+    exit 0
+fi
+
+# Run zeroperl_preinit (PERL_SYS_INIT, perl_parse/perl_run and `use` of each
+# PRELOAD module) at build time and bake the resulting memory into the module
+cd "$WASM_DIR"
+ZEROPERL_PRELOAD="$PRELOAD" node "$REPO_DIR/tools/preinit.js" \
+    -i zeroperl.wasm -o zeroperl.preinit.wasm --init-func zeroperl_preinit
+mv zeroperl.preinit.wasm zeroperl.wasm
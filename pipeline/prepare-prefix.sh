@@ -4,6 +4,7 @@ set -e
 PERL_VERSION="${PERL_VERSION:-5.42.0}"
 BUILD_EXIFTOOL="${BUILD_EXIFTOOL:-true}"
 TRIM="${TRIM:-true}"
+COMPRESS="${COMPRESS:-false}"
 NATIVE_DIR="${NATIVE_DIR:-/build/native}"
 REPO_DIR="${REPO_DIR:-/build/repo}"
 NPROC="${NPROC:-$(nproc)}"
@@ -29,6 +30,17 @@ if [ "$TRIM" = "true" ]; then
         "perltidy --delete-block-comments --delete-side-comments --delete-pod --backup-and-modify-in-place --backup-file-extension='/' '{}'"
 fi
 
+SFS_FLAGS=""
+if [ "$COMPRESS" = "true" ]; then
+    SFS_FLAGS="--compress"
+fi
+
+# Embedded @INC directories, in Perl's default search order, for the module index
+for dir in "lib/site_perl/$PERL_VERSION/wasm32-wasi" "lib/site_perl/$PERL_VERSION" \
+           "lib/$PERL_VERSION/wasm32-wasi" "lib/$PERL_VERSION"; do
+    SFS_FLAGS="$SFS_FLAGS --inc $dir"
+done
+
 mkdir -p "$REPO_DIR/gen"
-node "$REPO_DIR/tools/sfs.js" -i /zeroperl -o "$REPO_DIR/gen/zeroperl.h" --prefix /zeroperl
+node "$REPO_DIR/tools/sfs.js" -i /zeroperl -o "$REPO_DIR/gen/zeroperl.h" --prefix /zeroperl $SFS_FLAGS
 
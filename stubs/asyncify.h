@@ -1,11 +1,30 @@
 #ifndef ASYNCJMP_SUPPORT_ASYNCIFY_H
 #define ASYNCJMP_SUPPORT_ASYNCIFY_H
 
+// Profiling builds (ASYNCIFY_PROFILE in build-wasm.sh) can report each
+// unwind to the host first, so tools/asyncify-profile.js can record the call
+// stack. Reports stay off until the host calls the exported
+// asyncjmp_profile_enable(), so the module that is profiled is the one that
+// ships, and they reuse fd_write rather than adding an import (runtime.c).
+#ifdef ASYNCJMP_PROFILE
+extern int asyncjmp_profile_enabled;
+void asyncjmp_profile_report(void);
+#define asyncjmp_profile_unwind()          \
+    do                                     \
+    {                                      \
+        if (asyncjmp_profile_enabled)      \
+            asyncjmp_profile_report();     \
+    } while (0)
+#else
+#define asyncjmp_profile_unwind() ((void)0)
+#endif
+
 __attribute__((import_module("asyncify"), import_name("start_unwind"))) void asyncify_start_unwind(void *buf);
 #define asyncify_start_unwind(buf)         \
     do                                     \
     {                                      \
         extern void *pl_asyncify_unwind_buf; \
+        asyncjmp_profile_unwind();         \
         pl_asyncify_unwind_buf = (buf);      \
         asyncify_start_unwind((buf));      \
     } while (0)
@@ -3,6 +3,28 @@
 #include "setjmp.h"
 #include <stdlib.h>
 
+#ifdef ASYNCJMP_PROFILE
+#include <wasi/api.h>
+
+// Descriptor no WASI host hands out; tools/asyncify-profile.js answers
+// writes to it
+#define ASYNCJMP_PROFILE_FD 0x7ffffffe
+
+int asyncjmp_profile_enabled = 0;
+
+__attribute__((export_name("asyncjmp_profile_enable"))) void asyncjmp_profile_enable(void)
+{
+    asyncjmp_profile_enabled = 1;
+}
+
+// noinline so the profiler can drop this frame by name
+__attribute__((noinline)) void asyncjmp_profile_report(void)
+{
+    size_t written;
+    __wasi_fd_write(ASYNCJMP_PROFILE_FD, NULL, 0, &written);
+}
+#endif
+
 int asyncjmp_rt_start(int(main)(int argc, char **argv), int argc, char **argv)
 {
     int result;
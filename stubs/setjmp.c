@@ -30,7 +30,9 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef ASYNCJMP_ENABLE_DEBUG_LOG
 #define STRINGIZE_HELPER(x) #x
@@ -74,16 +76,165 @@ enum asyncjmp_jmp_buf_state
     JMP_BUF_STATE_RETURNING = 3,
 };
 
-void async_buf_init(struct __asyncjmp_asyncify_jmp_buf *buf)
-{
-    buf->top = &buf->buffer[0];
-    buf->end = &buf->buffer[WASM_SETJMP_STACK_BUFFER_SIZE];
-}
-
 // Global unwinding/rewinding jmpbuf state
 static asyncjmp_jmp_buf *_asyncjmp_active_jmpbuf;
 void *pl_asyncify_unwind_buf;
 
+//
+// Save areas
+//
+// Every unwind goes into one shared scratch area. A capture is copied from
+// there into a block just big enough for it, taken from a pool of
+// power-of-two size classes and owned by the jmp_buf; the unwind of a
+// longjmp is never rewound and is simply dropped. A jmp_buf has no
+// destructor, so a block is reclaimed once the jmp_buf lies in a stack
+// frame that has returned, i.e. below the stack pointer, or when the same
+// jmp_buf is captured again.
+//
+
+extern unsigned char __stack_low[];
+
+static struct __asyncjmp_asyncify_jmp_buf scratch_buf;
+static char *scratch;
+static size_t scratch_size;
+
+struct asyncjmp_save
+{
+    asyncjmp_jmp_buf *env;
+    char *block;
+    unsigned size_class;
+};
+
+static struct asyncjmp_save *saves;
+static size_t saves_num;
+static size_t saves_cap;
+
+#define SAVE_MIN_CLASS 8
+#define SAVE_NUM_CLASSES 32
+static void *save_pool[SAVE_NUM_CLASSES];
+
+__attribute__((noreturn)) static void save_area_fail(const char *what, size_t size)
+{
+    fprintf(stderr, "asyncjmp: %s (%zu bytes)\n", what, size);
+    abort();
+}
+
+static struct __asyncjmp_asyncify_jmp_buf *scratch_begin(void)
+{
+    if (!scratch)
+    {
+        scratch_size = WASM_SETJMP_STACK_BUFFER_SIZE;
+        scratch = malloc(scratch_size);
+        if (!scratch)
+            save_area_fail("cannot allocate unwind area", scratch_size);
+    }
+    scratch_buf.top = scratch;
+    scratch_buf.end = scratch + scratch_size;
+    return &scratch_buf;
+}
+
+// Called once an unwind into the scratch area has stopped and its data is
+// no longer needed. The depth of an unwind is not known until it has run,
+// so the area cannot be sized beforehand; Asyncify checks every write
+// against the buffer's end and traps instead of writing past it. Keeping
+// at least half of the area free makes that take a stack more than twice
+// as deep as any seen before; raise WASM_SETJMP_STACK_BUFFER_SIZE if a
+// first deep unwind traps.
+static void scratch_end(void)
+{
+    size_t used = (char *)scratch_buf.top - scratch;
+    if (used > scratch_size / 2)
+    {
+        free(scratch);
+        scratch_size *= 2;
+        while (used > scratch_size / 2)
+            scratch_size *= 2;
+        scratch = malloc(scratch_size);
+        if (!scratch)
+            save_area_fail("cannot allocate unwind area", scratch_size);
+    }
+}
+
+static unsigned save_class(size_t size)
+{
+    unsigned c = SAVE_MIN_CLASS;
+    while (((size_t)1 << c) < size)
+        c++;
+    return c;
+}
+
+static void save_release(struct asyncjmp_save *save)
+{
+    *(void **)save->block = save_pool[save->size_class];
+    save_pool[save->size_class] = save->block;
+}
+
+// Moves the context just unwound into the scratch area to env's own block
+static void save_capture(asyncjmp_jmp_buf *env)
+{
+    char *sp = asyncjmp_get_stack_pointer();
+    size_t used = (char *)scratch_buf.top - scratch;
+    unsigned c = save_class(used);
+    struct asyncjmp_save *save = NULL;
+    size_t n = 0;
+
+    for (size_t i = 0; i < saves_num; i++)
+    {
+        char *at = (char *)saves[i].env;
+        if (at >= (char *)__stack_low && at < sp)
+        {
+            save_release(&saves[i]);
+            continue;
+        }
+        saves[n] = saves[i];
+        if (saves[n].env == env)
+            save = &saves[n];
+        n++;
+    }
+    saves_num = n;
+
+    if (save && save->size_class != c)
+    {
+        save_release(save);
+        save->block = NULL;
+    }
+    if (!save)
+    {
+        if (saves_num == saves_cap)
+        {
+            size_t cap = saves_cap ? saves_cap * 2 : 16;
+            struct asyncjmp_save *grown = realloc(saves, cap * sizeof(*saves));
+            if (!grown)
+                save_area_fail("cannot track save area", cap * sizeof(*saves));
+            saves = grown;
+            saves_cap = cap;
+        }
+        save = &saves[saves_num++];
+        save->env = env;
+        save->block = NULL;
+    }
+    if (!save->block)
+    {
+        if (c >= SAVE_NUM_CLASSES)
+            save_area_fail("context too large", used);
+        save->size_class = c;
+        if (save_pool[c])
+        {
+            save->block = save_pool[c];
+            save_pool[c] = *(void **)save->block;
+        }
+        else if (!(save->block = malloc((size_t)1 << c)))
+        {
+            save_area_fail("cannot allocate save area", (size_t)1 << c);
+        }
+    }
+
+    memcpy(save->block, scratch, used);
+    env->setjmp_buf.top = save->block + used;
+    env->setjmp_buf.end = save->block + ((size_t)1 << c);
+    env->dst_buf_top = env->setjmp_buf.top;
+}
+
 __attribute__((noinline)) int _asyncjmp_setjmp_internal(asyncjmp_jmp_buf *env)
 {
     ASYNCJMP_DEBUG_LOG("enter _asyncjmp_setjmp_internal");
@@ -94,10 +245,8 @@ __attribute__((noinline)) int _asyncjmp_setjmp_internal(asyncjmp_jmp_buf *env)
         ASYNCJMP_DEBUG_LOG("  JMP_BUF_STATE_INITIALIZED");
         env->state = JMP_BUF_STATE_CAPTURING;
         env->payload = 0;
-        env->longjmp_buf_ptr = NULL;
         _asyncjmp_active_jmpbuf = env;
-        async_buf_init(&env->setjmp_buf);
-        asyncify_start_unwind(&env->setjmp_buf);
+        asyncify_start_unwind(scratch_begin());
         return -1; // return a dummy value
     }
     case JMP_BUF_STATE_CAPTURING:
@@ -113,7 +262,6 @@ __attribute__((noinline)) int _asyncjmp_setjmp_internal(asyncjmp_jmp_buf *env)
         asyncify_stop_rewind();
         ASYNCJMP_DEBUG_LOG("  JMP_BUF_STATE_RETURNING");
         env->state = JMP_BUF_STATE_CAPTURED;
-        free(env->longjmp_buf_ptr);
         _asyncjmp_active_jmpbuf = NULL;
         return env->payload;
     }
@@ -131,12 +279,9 @@ void _asyncjmp_longjmp(asyncjmp_jmp_buf *env, int value)
     env->state = JMP_BUF_STATE_RETURNING;
     env->payload = value;
     // Asyncify buffer built during unwinding for longjmp will not
-    // be used to rewind, so re-use static-variable.
-    static struct __asyncjmp_asyncify_jmp_buf tmp_longjmp_buf;
-    env->longjmp_buf_ptr = &tmp_longjmp_buf;
+    // be used to rewind, so it goes to the scratch area.
     _asyncjmp_active_jmpbuf = env;
-    async_buf_init(env->longjmp_buf_ptr);
-    asyncify_start_unwind(env->longjmp_buf_ptr);
+    asyncify_start_unwind(scratch_begin());
 }
 
 enum try_catch_phase
@@ -196,6 +341,7 @@ void asyncjmp_try_catch_loop_run(struct asyncjmp_try_catch *try_catch,
             // (but call stop_rewind to update the asyncify state to "normal" from
             // "unwind")
             asyncify_stop_rewind();
+            scratch_end();
             // reset the stack pointer to what it was before the most recent call to try_f or catch_f
             asyncjmp_set_stack_pointer(try_catch->stack_pointer);
             // clear the active jmpbuf because it's already stopped
@@ -225,12 +371,13 @@ void *asyncjmp_handle_jmp_unwind(void)
     {
     case JMP_BUF_STATE_CAPTURING:
         ASYNCJMP_DEBUG_LOG("  JMP_BUF_STATE_CAPTURING");
-        // save the captured Asyncify stack top
-        _asyncjmp_active_jmpbuf->dst_buf_top =
-            _asyncjmp_active_jmpbuf->setjmp_buf.top;
+        // move the captured context out of the scratch area, saving its top
+        save_capture(_asyncjmp_active_jmpbuf);
+        scratch_end();
         break;
     case JMP_BUF_STATE_RETURNING:
         ASYNCJMP_DEBUG_LOG("  JMP_BUF_STATE_RETURNING");
+        scratch_end();
         // restore the saved Asyncify stack top
         _asyncjmp_active_jmpbuf->setjmp_buf.top =
             _asyncjmp_active_jmpbuf->dst_buf_top;
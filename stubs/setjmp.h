@@ -3,24 +3,50 @@
 
 #include <stdbool.h>
 
+#ifdef WASM_SETJMP_EH
+
+//
+// Exception-handling backend (SETJMP=eh / eh-legacy in build-wasm.sh)
+//
+// With -mllvm -wasm-enable-sjlj, LLVM lowers calls to setjmp/longjmp onto
+// WebAssembly exception handling, with wasi-libc's libsetjmp as runtime
+// support: longjmp throws and the frame that called setjmp catches it. There
+// is no Asyncify instrumentation and no unwinding to a root frame.
+//
+
+// Large enough for libsetjmp's jmp_buf layout
+typedef unsigned long long jmp_buf[8];
+
+int setjmp(jmp_buf env) __attribute__((returns_twice));
+_Noreturn void longjmp(jmp_buf env, int payload);
+
+// Entry points need no root frame to catch unwinds, so they run directly
+static inline int asyncjmp_rt_start(int(main)(int argc, char **argv), int argc, char **argv)
+{
+    return main(argc, argv);
+}
+
+#else
+
+// Initial size of the shared area Asyncify unwinds into. It grows whenever
+// an unwind fills more than half of it; captured contexts are then copied
+// out into right-sized pooled blocks (see setjmp.c).
 #ifndef WASM_SETJMP_STACK_BUFFER_SIZE
 #define WASM_SETJMP_STACK_BUFFER_SIZE 32768
 #endif
 
+// Asyncify data header: the saved context lies in [start, top), in a save
+// area allocated separately, and end bounds that area
 struct __asyncjmp_asyncify_jmp_buf
 {
     void *top;
     void *end;
-    char buffer[WASM_SETJMP_STACK_BUFFER_SIZE];
 };
 
 typedef struct
 {
-    // Internal Asyncify buffer space to save execution context
+    // Asyncify header of the captured execution context
     struct __asyncjmp_asyncify_jmp_buf setjmp_buf;
-    // Internal Asyncify buffer space used while unwinding from longjmp
-    // but never used for rewinding.
-    struct __asyncjmp_asyncify_jmp_buf *longjmp_buf_ptr;
     // Used to save top address of Asyncify stack `setjmp_buf`, which is
     // overwritten during first rewind.
     void *dst_buf_top;
@@ -71,8 +97,11 @@ struct asyncjmp_try_catch
 
 //
 // Lightweight try-catch API without unwinding to root frame.
+// Perl's JMPENV_RUN (patches/jmpenv.patch) is built on it when this is set.
 //
 
+#define ASYNCJMP_TRY_CATCH 1
+
 void asyncjmp_try_catch_init(struct asyncjmp_try_catch *try_catch,
                              asyncjmp_try_catch_func_t try_f,
                              asyncjmp_try_catch_func_t catch_f,
@@ -95,6 +124,9 @@ void asyncjmp_try_catch_loop_run(struct asyncjmp_try_catch *try_catch, asyncjmp_
 // Main function startup wrapper
 //
 
-int asyncjmp_rt_start(int(main)(int argc, char **argv), int argc, char **argv);
+// noinline so the root frame keeps its name for tools/asyncify-profile.js
+__attribute__((noinline)) int asyncjmp_rt_start(int(main)(int argc, char **argv), int argc, char **argv);
+
+#endif
 
 #endif
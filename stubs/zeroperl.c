@@ -5,11 +5,14 @@
 #include "XSUB.h"
 #include "asyncify.h"
 #include "perl.h"
+#include "perliol.h"
 #include "setjmp.h"
 #include "async_web_api.h"
 #include <assert.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <locale.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -18,10 +21,18 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#if SFS_HAS_COMPRESSED
+#include "zlib.h"
+#endif
+#ifdef __wasm_simd128__
+#include <wasm_simd128.h>
+#endif
 
 #define STRINGIZE_HELPER(x) #x
 #define STRINGIZE(x) STRINGIZE_HELPER(x)
 #include <wasi/api.h>
+#include <wasi/libc-environ.h>
+#include <wasi/libc.h>
 
 //! Export macro for public API functions - combines export_name for WASI with
 //! visibility attribute
@@ -63,6 +74,7 @@ static PerlInterpreter *zero_perl = NULL;
 //! Global state flags
 static bool zero_perl_system_initialized = false; // PERL_SYS_INIT3 called
 static bool zero_perl_can_evaluate = false; // perl_run called, ready for eval
+static bool zero_perl_preinitialized = false; // state baked in at build time
 
 //! Error message buffer (stores last Perl error from $@)
 static char zero_perl_error_buf[1024] = {0};
@@ -75,6 +87,7 @@ extern char **environ;
 //! External declarations for the underlying ("real") syscalls (wrapped via
 //! linker)
 extern FILE *__real_fopen(const char *path, const char *mode);
+extern int __real_fclose(FILE *stream);
 extern int __real_fileno(FILE *stream);
 extern int __real_open(const char *path, int flags, ...);
 extern int __real_close(int fd);
@@ -83,56 +96,65 @@ extern off_t __real_lseek(int fd, off_t offset, int whence);
 extern int __real_access(const char *path, int flags);
 extern int __real_stat(const char *restrict path,
                        struct stat *restrict statbuf);
+extern int __real_lstat(const char *restrict path,
+                        struct stat *restrict statbuf);
 extern int __real_fstat(int fd, struct stat *statbuf);
-
-//! Maximum number of file descriptors to track
-#ifndef FD_MAX_TRACK
-#define FD_MAX_TRACK 32
+extern DIR *__real_opendir(const char *path);
+extern struct dirent *__real_readdir(DIR *dirp);
+extern void __real_rewinddir(DIR *dirp);
+extern long __real_telldir(DIR *dirp);
+extern void __real_seekdir(DIR *dirp, long loc);
+extern int __real_dirfd(DIR *dirp);
+extern int __real_closedir(DIR *dirp);
+
+//! First descriptor number handed out for SFS files
+//! SFS descriptors live far above the range WASI hosts allocate from, so a
+//! single compare tells host descriptors apart. Host descriptors that reach
+//! the base are closed and refused by the open wrappers rather than aliased.
+#ifndef SFS_FD_BASE
+#define SFS_FD_BASE 0x40000000
 #endif
 
-//! Maximum number of open SFS (Simple File System) files
-#ifndef SFS_MAX_OPEN_FILES
-#define SFS_MAX_OPEN_FILES 16
+//! Maximum number of open SFS directory streams
+#ifndef SFS_MAX_OPEN_DIRS
+#define SFS_MAX_OPEN_DIRS 16
 #endif
 
-//! Tracks which file descriptors are in use
-static bool g_fd_in_use[FD_MAX_TRACK] = {false};
-
-//! Marks a file descriptor as in use (not thread-safe)
-static inline void fd_mark_in_use(int fd) {
-  if (fd >= 0 && fd < FD_MAX_TRACK) {
-    g_fd_in_use[fd] = true;
-  }
-}
-
-//! Marks a file descriptor as free
-static inline void fd_mark_free(int fd) {
-  if (fd >= 0 && fd < FD_MAX_TRACK) {
-    g_fd_in_use[fd] = false;
-  }
-}
-
-//! Checks if a file descriptor is in use
-//! Out-of-range FDs are treated as in use
-static inline bool fd_is_in_use(int fd) {
-  return (fd >= 0 && fd < FD_MAX_TRACK) ? g_fd_in_use[fd] : true;
-}
-
 //! SFS entry structure for tracking open virtual files
-//! Each slot tracks an integer FD, a FILE* (via fmemopen), file size, and a
-//! "used" flag
+//! Each slot tracks a cursor over the embedded bytes and a "used" flag.
+//! A FILE* (via fmemopen) is only created for fopen callers.
 typedef struct {
   bool used;
-  int fd;
   FILE *fp;
-  size_t size;
+  const struct sfs_entry *entry;
+  const unsigned char *start;
+  const unsigned char *end;
+  size_t pos;
 } SFS_Entry;
 
-//! Table of open SFS files
-static SFS_Entry sfs_table[SFS_MAX_OPEN_FILES];
+//! Open SFS files, indexed by fd - SFS_FD_BASE; grows on demand
+static SFS_Entry *sfs_fd_table = NULL;
+static size_t sfs_fd_table_size = 0;
+//! No slot below this index is free
+static size_t sfs_fd_free_hint = 0;
+//! Number of open SFS files that also have a FILE* (fopen callers)
+static size_t sfs_fp_count = 0;
+
+//! Directory stream over an embedded directory
+//! Positions 0 and 1 yield "." and "..", then the directory's children
+typedef struct {
+  bool used;
+  const struct sfs_dir *dir;
+  uint32_t pos;
+  union {
+    struct dirent ent;
+    char space[sizeof(struct dirent) + NAME_MAX + 1];
+  } u;
+} SFS_Dir;
 
-//! Starting FD offset for SFS (skips standard FDs 0-2)
-static int sfs_fd_start = 3;
+//! Table of open SFS directory streams; a DIR* handed out by __wrap_opendir
+//! points into this table, which is how the other wrappers recognize it
+static SFS_Dir sfs_dir_table[SFS_MAX_OPEN_DIRS];
 
 //! Result codes for SFS operations
 typedef enum { SFS_OK = 0, SFS_ERR = -1, SFS_NOT_OURS = -2 } SFS_Result;
@@ -145,7 +167,8 @@ typedef enum {
 } SFS_Stat_Result;
 
 //! Removes consecutive duplicate '/' from a path for canonicalization
-static void sfs_sanitize_path(char *dst, size_t dstsize, const char *src) {
+//! Returns the length of the sanitized path
+static size_t sfs_sanitize_path(char *dst, size_t dstsize, const char *src) {
   size_t j = 0, limit = (dstsize > 0) ? (dstsize - 1) : 0;
   for (size_t i = 0; src[i] != '\0' && j < limit; i++) {
     if (i > 0 && src[i] == '/' && src[i - 1] == '/') {
@@ -156,6 +179,7 @@ static void sfs_sanitize_path(char *dst, size_t dstsize, const char *src) {
   if (dstsize > 0) {
     dst[j] = '\0';
   }
+  return j;
 }
 
 //! Checks if a path begins with SFS_BUILTIN_PREFIX
@@ -164,86 +188,418 @@ static inline bool sfs_has_prefix(const char *path) {
   return (strncmp(path, SFS_BUILTIN_PREFIX, len) == 0);
 }
 
-//! Looks up a path in the SFS and returns its data if found
-//! Path is always sanitized before comparison
-static bool sfs_lookup_path(const char *path, const unsigned char **found_start,
-                            size_t *found_size) {
+//! Finds a sanitized path in the build-time hash index
+//! Returns the matching entry or NULL; probes stop at the first empty slot
+static const struct sfs_entry *sfs_index_find(const char *path, size_t len) {
+  uint32_t hash = sfs_path_hash(path, len);
+  uint32_t mask = SFS_INDEX_SIZE - 1;
+
+  for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    uint32_t idx = sfs_index[slot];
+    if (idx == 0) {
+      return NULL;
+    }
+    const struct sfs_entry *e = &sfs_entries[idx - 1];
+    if (e->hash == hash && strcmp(path, e->abspath) == 0) {
+      return e;
+    }
+  }
+}
+
+//! Finds a sanitized path in the build-time directory index
+static const struct sfs_dir *sfs_dir_index_find(const char *path, size_t len) {
+  uint32_t hash = sfs_path_hash(path, len);
+  uint32_t mask = SFS_DIR_INDEX_SIZE - 1;
+
+  for (uint32_t slot = hash & mask;; slot = (slot + 1) & mask) {
+    uint32_t idx = sfs_dir_index[slot];
+    if (idx == 0) {
+      return NULL;
+    }
+    const struct sfs_dir *d = &sfs_dirs[idx - 1];
+    if (d->hash == hash && strcmp(path, d->abspath) == 0) {
+      return d;
+    }
+  }
+}
+
+//! Flags for zeroperl_sfs_mount()
+typedef enum {
+  ZEROPERL_SFS_BORROW = 0, // serve the host's buffer in place
+  ZEROPERL_SFS_COPY = 1    // take a private copy; the host may free its own
+} zeroperl_sfs_mount_flags;
+
+//! A host buffer mounted at runtime with zeroperl_sfs_mount()
+//! entry comes first so handles can hold it as a plain sfs_entry pointer
+typedef struct {
+  struct sfs_entry entry;
+  unsigned char *owned; // private copy for ZEROPERL_SFS_COPY, else NULL
+  size_t refs;          // open handles; unmounted mounts are freed at zero
+  bool mounted;
+} SFS_Mount;
+
+//! Contents of every zero-length mount, so acquiring one never yields NULL
+static const unsigned char sfs_empty_file[1];
+
+//! Currently mounted files; small, so searched linearly after a hash check
+static SFS_Mount **sfs_mounts = NULL;
+static size_t sfs_mounts_num = 0;
+static size_t sfs_mounts_cap = 0;
+
+//! Finds a sanitized path among the runtime mounts
+static SFS_Mount *sfs_mount_find(const char *path, size_t len) {
+  uint32_t hash = sfs_path_hash(path, len);
+  for (size_t i = 0; i < sfs_mounts_num; i++) {
+    SFS_Mount *m = sfs_mounts[i];
+    if (m->entry.hash == hash && strcmp(path, m->entry.abspath) == 0) {
+      return m;
+    }
+  }
+  return NULL;
+}
+
+//! Removes a mount from lookup; its memory goes once no handle uses it
+static void sfs_mount_detach(SFS_Mount *m) {
+  for (size_t i = 0; i < sfs_mounts_num; i++) {
+    if (sfs_mounts[i] == m) {
+      sfs_mounts[i] = sfs_mounts[--sfs_mounts_num];
+      break;
+    }
+  }
+  m->mounted = false;
+  if (m->refs == 0) {
+    free(m->owned);
+    free(m);
+  }
+}
+
+//! Looks up a directory in the SFS; trailing slashes are ignored
+static const struct sfs_dir *sfs_lookup_dir(const char *path) {
   if (!sfs_has_prefix(path)) {
-    return false;
+    return NULL;
   }
 
   char sanitized[256];
-  sfs_sanitize_path(sanitized, sizeof(sanitized), path);
+  size_t len = sfs_sanitize_path(sanitized, sizeof(sanitized), path);
+  while (len > 1 && sanitized[len - 1] == '/') {
+    sanitized[--len] = '\0';
+  }
+  return sfs_dir_index_find(sanitized, len);
+}
+
+//! Looks up a path in the SFS and returns its entry if found
+//! Path is always sanitized before comparison
+//! Runtime mounts shadow embedded files at the same path
+static const struct sfs_entry *sfs_lookup_path(const char *path) {
+  bool prefixed = sfs_has_prefix(path);
+  if (!prefixed && sfs_mounts_num == 0) {
+    return NULL;
+  }
 
-  for (size_t i = 0; i < sfs_builtin_files_num; i++) {
-    if (strcmp(sanitized, sfs_entries[i].abspath) == 0) {
-      *found_start = sfs_entries[i].start;
-      *found_size = (size_t)(sfs_entries[i].end - sfs_entries[i].start);
-      return true;
+  char sanitized[256];
+  size_t len = sfs_sanitize_path(sanitized, sizeof(sanitized), path);
+  if (sfs_mounts_num > 0) {
+    SFS_Mount *m = sfs_mount_find(sanitized, len);
+    if (m) {
+      return &m->entry;
     }
   }
-  return false;
+  return prefixed ? sfs_index_find(sanitized, len) : NULL;
+}
+
+//! Checks if the SFS answers for a path: anything under SFS_BUILTIN_PREFIX
+//! plus mounted files elsewhere
+static inline bool sfs_owns_path(const char *path) {
+  return sfs_has_prefix(path) ||
+         (sfs_mounts_num > 0 && sfs_lookup_path(path) != NULL);
+}
+
+#if SFS_HAS_COMPRESSED
+//! Upper bound on bytes held by the decompressed-file cache
+#ifndef SFS_CACHE_MAX_BYTES
+#define SFS_CACHE_MAX_BYTES (8 * 1024 * 1024)
+#endif
+
+//! Maximum number of decompressed files held at once
+#ifndef SFS_CACHE_SLOTS
+#define SFS_CACHE_SLOTS 64
+#endif
+
+//! A decompressed file; slots with refs > 0 back an open handle and are
+//! never evicted
+typedef struct {
+  const struct sfs_entry *entry;
+  unsigned char *data;
+  unsigned refs;
+  uint64_t last_use;
+} SFS_Cache_Slot;
+
+static SFS_Cache_Slot sfs_cache[SFS_CACHE_SLOTS];
+static size_t sfs_cache_bytes = 0;
+static uint64_t sfs_cache_clock = 0;
+
+static voidpf sfs_zalloc(voidpf opaque, uInt items, uInt size) {
+  (void)opaque;
+  return calloc(items, size);
+}
+
+static void sfs_zfree(voidpf opaque, voidpf ptr) {
+  (void)opaque;
+  free(ptr);
+}
+
+//! Inflates a compressed entry into a freshly malloc'd buffer
+static unsigned char *sfs_inflate(const struct sfs_entry *e) {
+  unsigned char *out = (unsigned char *)malloc(e->size ? e->size : 1);
+  if (!out) {
+    errno = ENOMEM;
+    return NULL;
+  }
+
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  zs.zalloc = sfs_zalloc;
+  zs.zfree = sfs_zfree;
+  zs.next_in = (Bytef *)e->start;
+  zs.avail_in = (uInt)(e->end - e->start);
+  zs.next_out = out;
+  zs.avail_out = (uInt)e->size;
+
+  int rc = inflateInit(&zs);
+  if (rc == Z_OK) {
+    rc = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+  }
+  if (rc != Z_STREAM_END || zs.total_out != e->size) {
+    free(out);
+    errno = EIO;
+    return NULL;
+  }
+  return out;
+}
+
+//! Drops the least recently used unpinned slot
+//! Returns false if every occupied slot is pinned
+static bool sfs_cache_evict_one(void) {
+  SFS_Cache_Slot *victim = NULL;
+  for (int i = 0; i < SFS_CACHE_SLOTS; i++) {
+    SFS_Cache_Slot *slot = &sfs_cache[i];
+    if (slot->entry && slot->refs == 0 &&
+        (!victim || slot->last_use < victim->last_use)) {
+      victim = slot;
+    }
+  }
+  if (!victim) {
+    return false;
+  }
+  sfs_cache_bytes -= victim->entry->size;
+  free(victim->data);
+  memset(victim, 0, sizeof(*victim));
+  return true;
+}
+
+//! Returns a pinned, decompressed copy of a compressed entry
+static const unsigned char *sfs_cache_acquire(const struct sfs_entry *e) {
+  SFS_Cache_Slot *free_slot = NULL;
+  for (int i = 0; i < SFS_CACHE_SLOTS; i++) {
+    SFS_Cache_Slot *slot = &sfs_cache[i];
+    if (slot->entry == e) {
+      slot->refs++;
+      slot->last_use = ++sfs_cache_clock;
+      return slot->data;
+    }
+    if (!slot->entry && !free_slot) {
+      free_slot = slot;
+    }
+  }
+
+  // Oversized files still get cached while pinned; the budget is restored
+  // as soon as they are released and evicted
+  while (sfs_cache_bytes + e->size > SFS_CACHE_MAX_BYTES &&
+         sfs_cache_evict_one()) {
+  }
+
+  if (!free_slot) {
+    if (!sfs_cache_evict_one()) {
+      errno = ENFILE;
+      return NULL;
+    }
+    for (int i = 0; i < SFS_CACHE_SLOTS; i++) {
+      if (!sfs_cache[i].entry) {
+        free_slot = &sfs_cache[i];
+        break;
+      }
+    }
+  }
+
+  unsigned char *data = sfs_inflate(e);
+  if (!data) {
+    return NULL;
+  }
+
+  free_slot->entry = e;
+  free_slot->data = data;
+  free_slot->refs = 1;
+  free_slot->last_use = ++sfs_cache_clock;
+  sfs_cache_bytes += e->size;
+  return data;
+}
+
+//! Unpins a cached entry; it stays cached until evicted
+static void sfs_cache_release(const struct sfs_entry *e) {
+  for (int i = 0; i < SFS_CACHE_SLOTS; i++) {
+    if (sfs_cache[i].entry == e) {
+      if (sfs_cache[i].refs > 0) {
+        sfs_cache[i].refs--;
+      }
+      return;
+    }
+  }
+}
+#endif
+
+//! Checks if an entry is a runtime mount rather than part of sfs_entries[]
+static inline bool sfs_entry_is_mount(const struct sfs_entry *e) {
+  return e < sfs_entries || e >= sfs_entries + sfs_builtin_files_num;
+}
+
+//! Returns the contents of an entry, decompressing on first use
+//! Every successful call must be paired with sfs_entry_release()
+static const unsigned char *sfs_entry_acquire(const struct sfs_entry *e) {
+  if (sfs_entry_is_mount(e)) {
+    ((SFS_Mount *)e)->refs++;
+    return e->start;
+  }
+#if SFS_HAS_COMPRESSED
+  if (e->compressed) {
+    return sfs_cache_acquire(e);
+  }
+#endif
+  return e->start;
+}
+
+//! Releases contents obtained from sfs_entry_acquire()
+static void sfs_entry_release(const struct sfs_entry *e) {
+  if (sfs_entry_is_mount(e)) {
+    SFS_Mount *m = (SFS_Mount *)e;
+    if (--m->refs == 0 && !m->mounted) {
+      free(m->owned);
+      free(m);
+    }
+    return;
+  }
+#if SFS_HAS_COMPRESSED
+  if (e->compressed) {
+    sfs_cache_release(e);
+  }
+#else
+  (void)e;
+#endif
 }
 
-//! Finds the next free descriptor in [sfs_fd_start..FD_MAX_TRACK-1]
-//! Forcibly exits if no free FDs are available
+//! Claims a free slot in the SFS descriptor table, growing it if needed
+//! Returns the new FD, or -1 with errno set if the table cannot grow
 static int sfs_allocate_fd(void) {
-  for (int fd = sfs_fd_start; fd < FD_MAX_TRACK; fd++) {
-    if (!fd_is_in_use(fd)) {
-      fd_mark_in_use(fd);
-      return fd;
+  size_t i = sfs_fd_free_hint;
+  while (i < sfs_fd_table_size && sfs_fd_table[i].used) {
+    i++;
+  }
+
+  if (i == sfs_fd_table_size) {
+    size_t new_size = sfs_fd_table_size ? sfs_fd_table_size * 2 : 16;
+    if (new_size > (size_t)(INT_MAX - SFS_FD_BASE)) {
+      errno = EMFILE;
+      return -1;
+    }
+    SFS_Entry *table =
+        (SFS_Entry *)realloc(sfs_fd_table, new_size * sizeof(SFS_Entry));
+    if (!table) {
+      errno = ENFILE;
+      return -1;
     }
+    memset(table + sfs_fd_table_size, 0,
+           (new_size - sfs_fd_table_size) * sizeof(SFS_Entry));
+    sfs_fd_table = table;
+    sfs_fd_table_size = new_size;
   }
-  __wasi_proc_exit(10);
-  return -1;
+
+  sfs_fd_table[i].used = true;
+  sfs_fd_free_hint = i + 1;
+  return SFS_FD_BASE + (int)i;
 }
 
 //! Finds an SFS table entry by file descriptor
-static SFS_Entry *sfs_find_by_fd(int fd) {
-  for (int i = 0; i < SFS_MAX_OPEN_FILES; i++) {
-    if (sfs_table[i].used && sfs_table[i].fd == fd) {
-      return &sfs_table[i];
-    }
+//! Host descriptors are rejected by a single range check
+static inline SFS_Entry *sfs_find_by_fd(int fd) {
+  if (fd < SFS_FD_BASE) {
+    return NULL;
   }
-  return NULL;
+  size_t i = (size_t)(fd - SFS_FD_BASE);
+  if (i >= sfs_fd_table_size || !sfs_fd_table[i].used) {
+    return NULL;
+  }
+  return &sfs_fd_table[i];
 }
 
-//! Opens a path from SFS using fmemopen and allocates an FD
+//! Opens a path from SFS and allocates an FD
+//! Reads are served straight from the embedded data; a FILE* is only built
+//! (via fmemopen) when outfp is requested
 static int sfs_open(const char *path, FILE **outfp) {
-  const unsigned char *start = NULL;
-  size_t size = 0;
+  if (outfp)
+    *outfp = NULL;
 
-  if (!sfs_lookup_path(path, &start, &size)) {
-    errno = ENOENT;
-    if (outfp)
-      *outfp = NULL;
+  const struct sfs_entry *entry = sfs_lookup_path(path);
+  if (!entry) {
+    errno = sfs_lookup_dir(path) ? EISDIR : ENOENT;
     return -1;
   }
 
-  FILE *fp = fmemopen((void *)start, size, "rb");
-  if (!fp) {
-    if (outfp)
-      *outfp = NULL;
+  const unsigned char *start = sfs_entry_acquire(entry);
+  if (!start) {
     return -1;
   }
 
-  for (int i = 0; i < SFS_MAX_OPEN_FILES; i++) {
-    if (!sfs_table[i].used) {
-      int newfd = sfs_allocate_fd();
-      sfs_table[i].used = true;
-      sfs_table[i].fd = newfd;
-      sfs_table[i].fp = fp;
-      sfs_table[i].size = size;
-      if (outfp)
-        *outfp = fp;
-      return newfd;
+  FILE *fp = NULL;
+  if (outfp) {
+    fp = fmemopen((void *)start, entry->size, "rb");
+    if (!fp) {
+      sfs_entry_release(entry);
+      return -1;
     }
   }
 
-  fclose(fp);
-  errno = EMFILE;
-  if (outfp)
-    *outfp = NULL;
+  int newfd = sfs_allocate_fd();
+  if (newfd < 0) {
+    if (fp)
+      __real_fclose(fp);
+    sfs_entry_release(entry);
+    return -1;
+  }
+
+  SFS_Entry *e = &sfs_fd_table[newfd - SFS_FD_BASE];
+  e->fp = fp;
+  e->entry = entry;
+  e->start = start;
+  e->end = start + entry->size;
+  e->pos = 0;
+  if (fp) {
+    sfs_fp_count++;
+    *outfp = fp;
+  }
+  return newfd;
+}
+
+//! Finds the SFS descriptor backing a FILE* returned by __wrap_fopen
+//! Only scans when such a FILE* is actually open
+static int sfs_find_by_fp(FILE *fp) {
+  if (sfs_fp_count == 0) {
+    return -1;
+  }
+  for (size_t i = 0; i < sfs_fd_table_size; i++) {
+    if (sfs_fd_table[i].used && sfs_fd_table[i].fp == fp) {
+      return SFS_FD_BASE + (int)i;
+    }
+  }
   return -1;
 }
 
@@ -253,16 +609,18 @@ static SFS_Result sfs_close(int fd) {
   if (!e) {
     return SFS_NOT_OURS;
   }
-  if (!e->fp) {
-    return SFS_ERR;
+
+  if (e->fp) {
+    __real_fclose(e->fp);
+    sfs_fp_count--;
   }
+  sfs_entry_release(e->entry);
+  memset(e, 0, sizeof(*e));
 
-  fclose(e->fp);
-  e->fp = NULL;
-  fd_mark_free(e->fd);
-  e->used = false;
-  e->fd = -1;
-  e->size = 0;
+  size_t i = (size_t)(fd - SFS_FD_BASE);
+  if (i < sfs_fd_free_hint) {
+    sfs_fd_free_hint = i;
+  }
   return SFS_OK;
 }
 
@@ -270,33 +628,54 @@ static SFS_Result sfs_close(int fd) {
 __attribute__((noinline)) static ssize_t sfs_read(int fd, void *buf,
                                                   size_t count) {
   SFS_Entry *e = sfs_find_by_fd(fd);
-  if (!e || !e->fp) {
+  if (!e) {
     return -1;
   }
-  return (ssize_t)fread(buf, 1, count, e->fp);
+  size_t size = (size_t)(e->end - e->start);
+  if (e->pos >= size) {
+    return 0;
+  }
+  size_t avail = size - e->pos;
+  if (count > avail) {
+    count = avail;
+  }
+  memcpy(buf, e->start + e->pos, count);
+  e->pos += count;
+  return (ssize_t)count;
 }
 
-//! Performs fseek/ftell if FD is ours
+//! Moves the read cursor if FD is ours
 static off_t sfs_lseek(int fd, off_t offset, int whence) {
   SFS_Entry *e = sfs_find_by_fd(fd);
-  if (!e || !e->fp) {
+  if (!e) {
     return (off_t)-1;
   }
-  if (fseek(e->fp, (long)offset, whence) != 0) {
+  off_t base;
+  switch (whence) {
+  case SEEK_SET:
+    base = 0;
+    break;
+  case SEEK_CUR:
+    base = (off_t)e->pos;
+    break;
+  case SEEK_END:
+    base = (off_t)(e->end - e->start);
+    break;
+  default:
+    errno = EINVAL;
     return (off_t)-1;
   }
-  long pos = ftell(e->fp);
-  if (pos < 0) {
+  if (offset < -base) {
+    errno = EINVAL;
     return (off_t)-1;
   }
-  return (off_t)pos;
+  e->pos = (size_t)(base + offset);
+  return (off_t)e->pos;
 }
 
 //! Checks if a path exists in SFS - no fallback if path has our prefix
 static int sfs_access(const char *path) {
-  const unsigned char *start = NULL;
-  size_t size = 0;
-  if (sfs_lookup_path(path, &start, &size)) {
+  if (sfs_lookup_path(path) || sfs_lookup_dir(path)) {
     return 0;
   }
   errno = ENOENT;
@@ -307,15 +686,22 @@ static int sfs_access(const char *path) {
 //! If path != NULL: path-based. If path == NULL: FD-based
 static SFS_Stat_Result sfs_stat(const char *path, int fd, struct stat *stbuf) {
   if (path) {
-    if (sfs_has_prefix(path)) {
-      const unsigned char *start = NULL;
-      size_t size = 0;
-      if (!sfs_lookup_path(path, &start, &size)) {
-        errno = ENOENT;
-        return SFS_STAT_ERR;
+    if (sfs_owns_path(path)) {
+      const struct sfs_entry *entry = sfs_lookup_path(path);
+      if (!entry) {
+        const struct sfs_dir *dir = sfs_lookup_dir(path);
+        if (!dir) {
+          errno = ENOENT;
+          return SFS_STAT_ERR;
+        }
+        memset(stbuf, 0, sizeof(*stbuf));
+        stbuf->st_ino = (ino_t)(sfs_builtin_files_num + (dir - sfs_dirs) + 1);
+        stbuf->st_nlink = 2;
+        stbuf->st_mode = S_IFDIR;
+        return SFS_STAT_OURS;
       }
       memset(stbuf, 0, sizeof(*stbuf));
-      stbuf->st_size = (off_t)size;
+      stbuf->st_size = (off_t)entry->size;
       stbuf->st_mode = S_IFREG;
       return SFS_STAT_OURS;
     }
@@ -326,7 +712,7 @@ static SFS_Stat_Result sfs_stat(const char *path, int fd, struct stat *stbuf) {
       return SFS_STAT_NOT_OURS;
     }
     memset(stbuf, 0, sizeof(*stbuf));
-    stbuf->st_size = (off_t)e->size;
+    stbuf->st_size = (off_t)(e->end - e->start);
     stbuf->st_mode = S_IFREG;
     return SFS_STAT_OURS;
   }
@@ -335,7 +721,11 @@ static SFS_Stat_Result sfs_stat(const char *path, int fd, struct stat *stbuf) {
 //! Wrapper for fopen: tries SFS first, then falls back to real fopen
 __attribute__((noinline)) FILE *__wrap_fopen(const char *path,
                                              const char *mode) {
-  if (sfs_has_prefix(path)) {
+  if (sfs_owns_path(path)) {
+    if (strpbrk(mode, "wa+")) {
+      errno = EROFS;
+      return NULL;
+    }
     FILE *fp = NULL;
     int sfd = sfs_open(path, &fp);
     if (sfd >= 0) {
@@ -344,14 +734,13 @@ __attribute__((noinline)) FILE *__wrap_fopen(const char *path,
     return NULL;
   }
 
-  FILE *realfp = __real_fopen(path, mode);
-  if (realfp) {
-    int realfd = fileno(realfp);
-    if (realfd >= 0 && realfd < FD_MAX_TRACK) {
-      fd_mark_in_use(realfd);
-    }
+  FILE *fp = __real_fopen(path, mode);
+  if (fp && __real_fileno(fp) >= SFS_FD_BASE) {
+    __real_fclose(fp);
+    errno = EMFILE;
+    return NULL;
   }
-  return realfp;
+  return fp;
 }
 
 //! Wrapper for open: tries SFS first, then falls back to real open
@@ -364,7 +753,12 @@ __attribute__((noinline)) int __wrap_open(const char *path, int flags, ...) {
   }
   va_end(args);
 
-  if (sfs_has_prefix(path)) {
+  if (sfs_owns_path(path)) {
+    int acc = flags & O_ACCMODE;
+    if (acc == O_WRONLY || acc == O_RDWR || (flags & O_TRUNC)) {
+      errno = EROFS;
+      return -1;
+    }
     int sfd = sfs_open(path, NULL);
     if (sfd >= 0) {
       return sfd;
@@ -372,11 +766,13 @@ __attribute__((noinline)) int __wrap_open(const char *path, int flags, ...) {
     return -1;
   }
 
-  int realfd = __real_open(path, flags, mode);
-  if (realfd >= 0 && realfd < FD_MAX_TRACK) {
-    fd_mark_in_use(realfd);
+  int fd = __real_open(path, flags, mode);
+  if (fd >= SFS_FD_BASE) {
+    __real_close(fd);
+    errno = EMFILE;
+    return -1;
   }
-  return realfd;
+  return fd;
 }
 
 //! Wrapper for close: tries SFS first, then falls back to real close
@@ -386,17 +782,23 @@ __attribute__((noinline)) int __wrap_close(int fd) {
     return 0;
   }
   if (rc == SFS_NOT_OURS) {
-    if (fd >= 0 && fd < FD_MAX_TRACK) {
-      fd_mark_free(fd);
-    }
     return __real_close(fd);
   }
   return (int)rc;
 }
 
+//! Wrapper for fclose: releases the SFS descriptor behind an SFS FILE*
+__attribute__((noinline)) int __wrap_fclose(FILE *stream) {
+  int sfd = sfs_find_by_fp(stream);
+  if (sfd >= 0) {
+    return sfs_close(sfd) == SFS_OK ? 0 : EOF;
+  }
+  return __real_fclose(stream);
+}
+
 //! Wrapper for access: tries SFS first, then falls back to real access
 __attribute__((noinline)) int __wrap_access(const char *path, int amode) {
-  if (sfs_has_prefix(path)) {
+  if (sfs_owns_path(path)) {
     return sfs_access(path);
   }
   return __real_access(path, amode);
@@ -415,6 +817,20 @@ __attribute__((noinline)) int __wrap_stat(const char *restrict path,
   return __real_stat(path, stbuf);
 }
 
+//! Wrapper for lstat: SFS has no symlinks, so its entries stat the same
+//! way; anything else falls back to real lstat
+__attribute__((noinline)) int __wrap_lstat(const char *restrict path,
+                                           struct stat *restrict stbuf) {
+  SFS_Stat_Result rc = sfs_stat(path, -1, stbuf);
+  if (rc == SFS_STAT_OURS) {
+    return 0;
+  }
+  if (rc == SFS_STAT_ERR) {
+    return -1;
+  }
+  return __real_lstat(path, stbuf);
+}
+
 //! Wrapper for fstat: tries SFS first, then falls back to real fstat
 __attribute__((noinline)) int __wrap_fstat(int fd, struct stat *stbuf) {
   SFS_Stat_Result rc = sfs_stat(NULL, fd, stbuf);
@@ -447,80 +863,1171 @@ __attribute__((noinline)) off_t __wrap_lseek(int fd, off_t offset, int whence) {
 
 //! Wrapper for fileno: checks SFS first, then falls back to real fileno
 __attribute__((noinline)) int __wrap_fileno(FILE *stream) {
-  for (int i = 0; i < SFS_MAX_OPEN_FILES; i++) {
-    if (sfs_table[i].used && sfs_table[i].fp == stream) {
-      return sfs_table[i].fd;
-    }
+  int sfd = sfs_find_by_fp(stream);
+  if (sfd >= 0) {
+    return sfd;
   }
+  return __real_fileno(stream);
+}
 
-  int realfd = __real_fileno(stream);
-  if (realfd >= 0 && realfd < FD_MAX_TRACK) {
-    fd_mark_in_use(realfd);
+//! Returns the SFS directory stream behind a DIR*, or NULL if it is a real one
+static inline SFS_Dir *sfs_dir_from_handle(DIR *dirp) {
+  SFS_Dir *d = (SFS_Dir *)dirp;
+  if (d >= sfs_dir_table && d < sfs_dir_table + SFS_MAX_OPEN_DIRS) {
+    return d;
   }
-  return realfd;
+  return NULL;
 }
 
-//! Opaque handle to a Perl scalar value
-typedef struct zeroperl_value_s {
-  SV *sv;
-} zeroperl_value;
-
-//! Opaque handle to a Perl array
-typedef struct zeroperl_array_s {
-  AV *av;
-} zeroperl_array;
+//! Wrapper for opendir: serves embedded directories from memory
+__attribute__((noinline)) DIR *__wrap_opendir(const char *path) {
+  if (!sfs_has_prefix(path)) {
+    return __real_opendir(path);
+  }
 
-//! Opaque handle to a Perl hash
-typedef struct zeroperl_hash_s {
-  HV *hv;
-} zeroperl_hash;
+  const struct sfs_dir *dir = sfs_lookup_dir(path);
+  if (!dir) {
+    errno = sfs_lookup_path(path) ? ENOTDIR : ENOENT;
+    return NULL;
+  }
 
-//! Opaque handle to a Perl code reference
-typedef struct zeroperl_code_s {
-  CV *cv;
-} zeroperl_code;
+  for (int i = 0; i < SFS_MAX_OPEN_DIRS; i++) {
+    if (!sfs_dir_table[i].used) {
+      sfs_dir_table[i].used = true;
+      sfs_dir_table[i].dir = dir;
+      sfs_dir_table[i].pos = 0;
+      return (DIR *)&sfs_dir_table[i];
+    }
+  }
 
-//! Result structure for operations that return multiple values
-typedef struct zeroperl_result_s {
-  int count;
-  zeroperl_value **values;
-} zeroperl_result;
+  errno = EMFILE;
+  return NULL;
+}
 
-//! Iterator for hash traversal
-typedef struct zeroperl_hash_iter_s {
-  HV *hv;
-  HE *entry;
-} zeroperl_hash_iter;
+//! Wrapper for readdir: walks the embedded children of an SFS directory
+__attribute__((noinline)) struct dirent *__wrap_readdir(DIR *dirp) {
+  SFS_Dir *d = sfs_dir_from_handle(dirp);
+  if (!d) {
+    return __real_readdir(dirp);
+  }
+
+  struct dirent *ent = &d->u.ent;
+  const char *name;
+  if (d->pos < 2) {
+    name = d->pos == 0 ? "." : "..";
+    ent->d_ino = (ino_t)(sfs_builtin_files_num + (d->dir - sfs_dirs) + 1);
+    ent->d_type = DT_DIR;
+  } else if (d->pos - 2 < d->dir->count) {
+    const struct sfs_dirent *child = &sfs_dirents[d->dir->first + d->pos - 2];
+    name = child->name;
+    if (child->is_dir) {
+      ent->d_ino = (ino_t)(sfs_builtin_files_num + child->index + 1);
+      ent->d_type = DT_DIR;
+    } else {
+      ent->d_ino = (ino_t)(child->index + 1);
+      ent->d_type = DT_REG;
+    }
+  } else {
+    return NULL;
+  }
 
-//! Context type for calling Perl code
-typedef enum {
-  ZEROPERL_VOID,
-  ZEROPERL_SCALAR,
-  ZEROPERL_LIST
-} zeroperl_context_type;
+  d->pos++;
+  strncpy(ent->d_name, name, NAME_MAX);
+  ent->d_name[NAME_MAX] = '\0';
+  return ent;
+}
 
-//! Value type enumeration
-typedef enum {
-  ZEROPERL_TYPE_UNDEF,
-  ZEROPERL_TYPE_TRUE,
-  ZEROPERL_TYPE_FALSE,
-  ZEROPERL_TYPE_INT,
-  ZEROPERL_TYPE_DOUBLE,
-  ZEROPERL_TYPE_STRING,
-  ZEROPERL_TYPE_ARRAY,
-  ZEROPERL_TYPE_HASH,
-  ZEROPERL_TYPE_CODE,
-  ZEROPERL_TYPE_REF
-} zeroperl_type;
+//! Wrapper for rewinddir: restarts an SFS directory stream
+__attribute__((noinline)) void __wrap_rewinddir(DIR *dirp) {
+  SFS_Dir *d = sfs_dir_from_handle(dirp);
+  if (!d) {
+    __real_rewinddir(dirp);
+    return;
+  }
+  d->pos = 0;
+}
 
-//! Operation type for unified context
-typedef enum {
-  ZEROPERL_OP_INIT,
-  ZEROPERL_OP_EVAL,
-  ZEROPERL_OP_RUN_FILE,
-  ZEROPERL_OP_RESET,
-  ZEROPERL_OP_CALL
-} zeroperl_op_type;
+//! Wrapper for telldir: an SFS position is the index readdir returns next
+__attribute__((noinline)) long __wrap_telldir(DIR *dirp) {
+  SFS_Dir *d = sfs_dir_from_handle(dirp);
+  if (!d) {
+    return __real_telldir(dirp);
+  }
+  return (long)d->pos;
+}
+
+//! Wrapper for seekdir: accepts positions from __wrap_telldir
+__attribute__((noinline)) void __wrap_seekdir(DIR *dirp, long loc) {
+  SFS_Dir *d = sfs_dir_from_handle(dirp);
+  if (!d) {
+    __real_seekdir(dirp, loc);
+    return;
+  }
+  uint32_t end = d->dir->count + 2;
+  d->pos = (loc < 0 || (unsigned long)loc > end) ? end : (uint32_t)loc;
+}
+
+//! Wrapper for dirfd: SFS directory streams have no descriptor
+__attribute__((noinline)) int __wrap_dirfd(DIR *dirp) {
+  SFS_Dir *d = sfs_dir_from_handle(dirp);
+  if (!d) {
+    return __real_dirfd(dirp);
+  }
+  errno = EBADF;
+  return -1;
+}
+
+//! Wrapper for closedir: releases an SFS directory stream
+__attribute__((noinline)) int __wrap_closedir(DIR *dirp) {
+  SFS_Dir *d = sfs_dir_from_handle(dirp);
+  if (!d) {
+    return __real_closedir(dirp);
+  }
+  d->used = false;
+  d->dir = NULL;
+  return 0;
+}
+
+//! Mount a host buffer as a read-only file at an absolute path
+//!
+//! Once mounted, open/fopen/read/stat and Perl's open serve the buffer
+//! through the SFS without any host calls; opening it for writing fails
+//! with EROFS. A mount shadows an embedded file
+//! at the same path and replaces an earlier mount there. Mounts are files
+//! only: they do not appear in directory listings.
+//!
+//! With ZEROPERL_SFS_BORROW the buffer is used in place and must stay valid
+//! until it is unmounted and every handle opened on it is closed. With
+//! ZEROPERL_SFS_COPY zeroperl keeps its own copy.
+//!
+//! Returns 0 on success, -1 with errno set on error.
+ZEROPERL_API("zeroperl_sfs_mount")
+int zeroperl_sfs_mount(const char *path, const void *data, size_t len,
+                       int flags) {
+  if (!path || path[0] != '/' || (!data && len > 0)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  char sanitized[256];
+  if (strlen(path) >= sizeof(sanitized)) {
+    errno = ENAMETOOLONG;
+    return -1;
+  }
+  size_t plen = sfs_sanitize_path(sanitized, sizeof(sanitized), path);
+  if (sanitized[plen - 1] == '/' || sfs_lookup_dir(sanitized)) {
+    errno = EISDIR;
+    return -1;
+  }
+
+  if (sfs_mounts_num == sfs_mounts_cap) {
+    size_t cap = sfs_mounts_cap ? sfs_mounts_cap * 2 : 8;
+    SFS_Mount **grown = realloc(sfs_mounts, cap * sizeof(*grown));
+    if (!grown) {
+      errno = ENOMEM;
+      return -1;
+    }
+    sfs_mounts = grown;
+    sfs_mounts_cap = cap;
+  }
+
+  SFS_Mount *m = malloc(sizeof(*m) + plen + 1);
+  if (!m) {
+    errno = ENOMEM;
+    return -1;
+  }
+  m->owned = NULL;
+  if ((flags & ZEROPERL_SFS_COPY) && len > 0) {
+    if (!(m->owned = malloc(len))) {
+      free(m);
+      errno = ENOMEM;
+      return -1;
+    }
+    memcpy(m->owned, data, len);
+    data = m->owned;
+  }
+  if (len == 0) {
+    data = sfs_empty_file;
+  }
+
+  char *abspath = (char *)(m + 1);
+  memcpy(abspath, sanitized, plen + 1);
+  m->entry.abspath = abspath;
+  m->entry.start = (const unsigned char *)data;
+  m->entry.end = m->entry.start + len;
+  m->entry.size = len;
+  m->entry.hash = sfs_path_hash(sanitized, plen);
+  m->entry.compressed = 0;
+  m->refs = 0;
+  m->mounted = true;
+
+  SFS_Mount *old = sfs_mount_find(sanitized, plen);
+  if (old) {
+    sfs_mount_detach(old);
+  }
+  sfs_mounts[sfs_mounts_num++] = m;
+  return 0;
+}
+
+//! Unmount a file mounted with zeroperl_sfs_mount()
+//!
+//! The path stops resolving immediately; handles already open on it keep
+//! reading until closed.
+//!
+//! Returns 0 on success, -1 with errno ENOENT if nothing is mounted there.
+ZEROPERL_API("zeroperl_sfs_unmount")
+int zeroperl_sfs_unmount(const char *path) {
+  char sanitized[256];
+  SFS_Mount *m = NULL;
+  if (path && strlen(path) < sizeof(sanitized)) {
+    size_t plen = sfs_sanitize_path(sanitized, sizeof(sanitized), path);
+    m = sfs_mount_find(sanitized, plen);
+  }
+  if (!m) {
+    errno = ENOENT;
+    return -1;
+  }
+  sfs_mount_detach(m);
+  return 0;
+}
+
+//! Native PerlIO layer over embedded SFS data
+//!
+//! The layer's "buffer" is the embedded file itself: Perl's fast-gets path
+//! (readline, the lexer) reads lines straight out of sfs_builtin_data without
+//! a read() call or an intermediate PerlIO buffer. It sits on top of the
+//! default layer list and hands any open it does not own to the layer below.
+typedef struct {
+  struct _PerlIO base;
+  const struct sfs_entry *entry;
+  const unsigned char *start;
+  const unsigned char *end;
+  const unsigned char *ptr;
+  int fd; // SFS descriptor for fileno(), allocated on first use; else -1
+} PerlIOSFS;
+
+static IV PerlIOSFS_pushed(pTHX_ PerlIO *f, const char *mode, SV *arg,
+                           PerlIO_funcs *tab) {
+  if (mode && (strchr(mode, 'w') || strchr(mode, 'a') || strchr(mode, '+'))) {
+    SETERRNO(EROFS, RMS_PRV);
+    return -1;
+  }
+
+  PerlIOSFS *s = PerlIOSelf(f, PerlIOSFS);
+  s->entry = NULL;
+  s->start = s->end = s->ptr = NULL;
+  s->fd = -1;
+  return PerlIOBase_pushed(aTHX_ f, mode, arg, tab);
+}
+
+//! Pushes an :sfs layer reading entry onto f (a fresh handle if NULL)
+static PerlIO *sfs_perlio_push_entry(pTHX_ PerlIO *f, PerlIO_funcs *self,
+                                     const char *mode,
+                                     const struct sfs_entry *entry) {
+  const unsigned char *start = sfs_entry_acquire(entry);
+  if (!start) {
+    return NULL;
+  }
+  if (!f) {
+    f = PerlIO_allocate(aTHX);
+  }
+  if ((f = PerlIO_push(aTHX_ f, self, mode, NULL))) {
+    PerlIOSFS *s = PerlIOSelf(f, PerlIOSFS);
+    s->entry = entry;
+    s->start = s->ptr = start;
+    s->end = start + entry->size;
+    PerlIOBase(f)->flags |= PERLIO_F_OPEN;
+  } else {
+    sfs_entry_release(entry);
+  }
+  return f;
+}
+
+static PerlIO *PerlIOSFS_open(pTHX_ PerlIO_funcs *self, PerlIO_list_t *layers,
+                              IV n, const char *mode, int fd, int imode,
+                              int perm, PerlIO *f, int narg, SV **args) {
+  const struct sfs_entry *entry = NULL;
+
+  if (fd < 0 && narg == 1 && !SvROK(*args) && mode) {
+    const char *m = (*mode == IoTYPE_IMPLICIT) ? mode + 1 : mode;
+    if (*m == 'r' && !strchr(m, '+') &&
+        (entry = sfs_lookup_path(SvPV_nolen(*args)))) {
+      return sfs_perlio_push_entry(aTHX_ f, self, m, entry);
+    }
+  }
+
+  for (IV i = n - 1; i >= 0; i--) {
+    PerlIO_funcs *tab = PerlIO_layer_fetch(aTHX_ layers, i, NULL);
+    if (tab && tab->Open) {
+      return (*tab->Open)(aTHX_ tab, layers, i, mode, fd, imode, perm, f,
+                          narg, args);
+    }
+  }
+
+  SETERRNO(EINVAL, LIB_INVARG);
+  return NULL;
+}
+
+//! Hands out an SFS descriptor over the same entry so stat($fh), -s $fh and
+//! fileno work through the wrapped fstat. The descriptor has its own cursor;
+//! reads through the handle do not move it.
+static IV PerlIOSFS_fileno(pTHX_ PerlIO *f) {
+  PerlIOSFS *s = PerlIOSelf(f, PerlIOSFS);
+  if (s->fd >= 0 || !s->entry) {
+    return s->fd;
+  }
+
+  int fd = sfs_allocate_fd();
+  if (fd < 0) {
+    return -1;
+  }
+  SFS_Entry *e = &sfs_fd_table[fd - SFS_FD_BASE];
+  e->fp = NULL;
+  e->entry = s->entry;
+  e->start = sfs_entry_acquire(s->entry);
+  e->end = s->end;
+  e->pos = 0;
+  s->fd = fd;
+  return fd;
+}
+
+static PerlIO *PerlIOSFS_dup(pTHX_ PerlIO *f, PerlIO *o, CLONE_PARAMS *param,
+                             int flags) {
+  if ((f = PerlIOBase_dup(aTHX_ f, o, param, flags))) {
+    PerlIOSFS *fs = PerlIOSelf(f, PerlIOSFS);
+    PerlIOSFS *os = PerlIOSelf(o, PerlIOSFS);
+    if (os->entry) {
+      sfs_entry_acquire(os->entry);
+    }
+    fs->entry = os->entry;
+    fs->start = os->start;
+    fs->end = os->end;
+    fs->ptr = os->ptr;
+    fs->fd = -1;
+  }
+  return f;
+}
+
+static SSize_t PerlIOSFS_read(pTHX_ PerlIO *f, void *vbuf, Size_t count) {
+  PerlIOSFS *s = PerlIOSelf(f, PerlIOSFS);
+  Size_t avail = (Size_t)(s->end - s->ptr);
+  if (count > avail) {
+    count = avail;
+  }
+  if (count == 0) {
+    PerlIOBase(f)->flags |= PERLIO_F_EOF;
+    return 0;
+  }
+  memcpy(vbuf, s->ptr, count);
+  s->ptr += count;
+  return (SSize_t)count;
+}
+
+static SSize_t PerlIOSFS_write(pTHX_ PerlIO *f, const void *vbuf,
+                               Size_t count) {
+  PERL_UNUSED_ARG(vbuf);
+  PERL_UNUSED_ARG(count);
+  PerlIOBase(f)->flags |= PERLIO_F_ERROR;
+  SETERRNO(EBADF, SS_IVCHAN);
+  return -1;
+}
+
+static IV PerlIOSFS_seek(pTHX_ PerlIO *f, Off_t offset, int whence) {
+  PerlIOSFS *s = PerlIOSelf(f, PerlIOSFS);
+  Off_t size = (Off_t)(s->end - s->start);
+  Off_t base;
+  switch (whence) {
+  case SEEK_SET:
+    base = 0;
+    break;
+  case SEEK_CUR:
+    base = (Off_t)(s->ptr - s->start);
+    break;
+  case SEEK_END:
+    base = size;
+    break;
+  default:
+    SETERRNO(EINVAL, SS_IVCHAN);
+    return -1;
+  }
+  Off_t pos = base + offset;
+  if (pos < 0) {
+    SETERRNO(EINVAL, SS_IVCHAN);
+    return -1;
+  }
+  s->ptr = s->start + (pos > size ? size : pos);
+  PerlIOBase(f)->flags &= ~PERLIO_F_EOF;
+  return 0;
+}
+
+static Off_t PerlIOSFS_tell(pTHX_ PerlIO *f) {
+  PerlIOSFS *s = PerlIOSelf(f, PerlIOSFS);
+  return (Off_t)(s->ptr - s->start);
+}
+
+static IV PerlIOSFS_close(pTHX_ PerlIO *f) {
+  PerlIOSFS *s = PerlIOSelf(f, PerlIOSFS);
+  if (s->fd >= 0) {
+    sfs_close(s->fd);
+    s->fd = -1;
+  }
+  if (s->entry) {
+    sfs_entry_release(s->entry);
+    s->entry = NULL;
+  }
+  s->start = s->end = s->ptr = NULL;
+  PerlIOBase(f)->flags &= ~PERLIO_F_OPEN;
+  return 0;
+}
+
+static IV PerlIOSFS_fill(pTHX_ PerlIO *f) {
+  PERL_UNUSED_ARG(f);
+  return -1;
+}
+
+static STDCHAR *PerlIOSFS_get_base(pTHX_ PerlIO *f) {
+  return (STDCHAR *)PerlIOSelf(f, PerlIOSFS)->start;
+}
+
+static Size_t PerlIOSFS_bufsiz(pTHX_ PerlIO *f) {
+  PerlIOSFS *s = PerlIOSelf(f, PerlIOSFS);
+  return (Size_t)(s->end - s->start);
+}
+
+static STDCHAR *PerlIOSFS_get_ptr(pTHX_ PerlIO *f) {
+  return (STDCHAR *)PerlIOSelf(f, PerlIOSFS)->ptr;
+}
+
+static SSize_t PerlIOSFS_get_cnt(pTHX_ PerlIO *f) {
+  PerlIOSFS *s = PerlIOSelf(f, PerlIOSFS);
+  return (SSize_t)(s->end - s->ptr);
+}
+
+static void PerlIOSFS_set_ptrcnt(pTHX_ PerlIO *f, STDCHAR *ptr, SSize_t cnt) {
+  PerlIOSFS *s = PerlIOSelf(f, PerlIOSFS);
+  PERL_UNUSED_ARG(ptr);
+  s->ptr = s->end - cnt;
+}
+
+static PERLIO_FUNCS_DECL(PerlIO_sfs) = {
+    sizeof(PerlIO_funcs),
+    "sfs",
+    sizeof(PerlIOSFS),
+    PERLIO_K_BUFFERED | PERLIO_K_RAW | PERLIO_K_FASTGETS,
+    PerlIOSFS_pushed,
+    PerlIOBase_popped,
+    PerlIOSFS_open,
+    PerlIOBase_binmode,
+    NULL,
+    PerlIOSFS_fileno,
+    PerlIOSFS_dup,
+    PerlIOSFS_read,
+    PerlIOBase_unread,
+    PerlIOSFS_write,
+    PerlIOSFS_seek,
+    PerlIOSFS_tell,
+    PerlIOSFS_close,
+    PerlIOBase_noop_ok,
+    PerlIOSFS_fill,
+    PerlIOBase_eof,
+    PerlIOBase_error,
+    PerlIOBase_clearerr,
+    PerlIOBase_setlinebuf,
+    PerlIOSFS_get_base,
+    PerlIOSFS_bufsiz,
+    PerlIOSFS_get_ptr,
+    PerlIOSFS_get_cnt,
+    PerlIOSFS_set_ptrcnt,
+};
+
+//! Registers the :sfs layer and puts it on top of the default layer list so
+//! plain opens (require, do FILE, open '<') of embedded files use it
+static void sfs_perlio_init(pTHX) {
+  PerlIO_funcs *tab = PERLIO_FUNCS_CAST(&PerlIO_sfs);
+  PerlIO_define_layer(aTHX_ tab);
+
+  PerlIO_list_t *def = PerlIO_default_layers(aTHX);
+  if (PerlIO_layer_fetch(aTHX_ def, def->cur - 1, NULL) != tab) {
+    PerlIO_list_push(aTHX_ def, tab, &PL_sv_undef);
+  }
+}
+
+//! @INC hook answering require from the build-time module index
+//!
+//! A hit costs one hash probe: the hook returns a #line prefix naming the
+//! embedded path (so __FILE__, caller and error messages match a normal
+//! require) and an :sfs handle over the file, and records that path in %INC.
+//! A miss, or a module whose embedded directory has been removed from @INC,
+//! returns the empty list and Perl carries on with the rest of @INC.
+static const struct sfs_module *sfs_module_find(const char *name, size_t len) {
+  if (sfs_builtin_modules_num == 0) {
+    return NULL;
+  }
+  uint32_t hash = sfs_path_hash(name, len);
+  uint32_t mask = SFS_MODULE_INDEX_SIZE - 1;
+  for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+    uint32_t slot = sfs_module_index[i];
+    if (slot == 0) {
+      return NULL;
+    }
+    const struct sfs_module *m = &sfs_modules[slot - 1];
+    if (m->hash == hash && strncmp(m->name, name, len) == 0 &&
+        m->name[len] == '\0') {
+      return m;
+    }
+  }
+}
+
+//! Position of embedded directory inc in @INC, or -1 if it is not there
+static SSize_t sfs_inc_position(pTHX_ AV *inc_av, uint32_t inc) {
+  const char *dir = sfs_inc_dirs[inc];
+  SSize_t top = av_top_index(inc_av);
+  for (SSize_t i = 0; i <= top; i++) {
+    SV **svp = av_fetch(inc_av, i, 0);
+    if (svp && SvPOK(*svp) && !SvROK(*svp) && strEQ(SvPVX(*svp), dir)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+static XS(xs_sfs_inc_hook) {
+  dXSARGS;
+  if (items < 2) {
+    XSRETURN_EMPTY;
+  }
+
+  STRLEN len;
+  const char *name = SvPV(ST(1), len);
+  const struct sfs_module *m = sfs_module_find(name, len);
+  if (!m || sfs_inc_position(aTHX_ GvAVn(PL_incgv), m->inc) < 0) {
+    XSRETURN_EMPTY;
+  }
+
+  const struct sfs_entry *entry = &sfs_entries[m->entry];
+  if (sfs_mounts_num > 0) {
+    entry = sfs_lookup_path(entry->abspath);
+  }
+  PerlIO *f = sfs_perlio_push_entry(aTHX_ NULL, PERLIO_FUNCS_CAST(&PerlIO_sfs),
+                                    "r", entry);
+  if (!f) {
+    XSRETURN_EMPTY;
+  }
+
+  GV *gv = (GV *)newSV(0);
+  gv_init_pvn(gv, gv_stashpvs("zeroperl::INC", GV_ADD), "SFS", 3, 0);
+  IO *io = GvIOn(gv);
+  IoIFP(io) = f;
+  IoTYPE(io) = IoTYPE_RDONLY;
+
+  (void)hv_store(GvHVn(PL_incgv), name, (I32)len,
+                 newSVpv(entry->abspath, 0), 0);
+
+  SP -= items;
+  EXTEND(SP, 2);
+  mPUSHs(newRV_noinc(
+      newSVpvf("#line 1 \"%s\"\n", entry->abspath)));
+  mPUSHs(newRV_noinc((SV *)gv));
+  PUTBACK;
+}
+
+//! Installs the hook just ahead of the first embedded directory in @INC, so
+//! -I, PERL5LIB and use lib entries placed before it keep their precedence
+static void sfs_inc_hook_init(pTHX) {
+  if (sfs_builtin_modules_num == 0) {
+    return;
+  }
+
+  AV *inc_av = GvAVn(PL_incgv);
+  SSize_t pos = -1;
+  for (uint32_t i = 0; i < SFS_INC_DIRS_NUM; i++) {
+    SSize_t p = sfs_inc_position(aTHX_ inc_av, i);
+    if (p >= 0 && (pos < 0 || p < pos)) {
+      pos = p;
+    }
+  }
+  if (pos < 0) {
+    return;
+  }
+
+  CV *cv = newXS(NULL, xs_sfs_inc_hook, __FILE__);
+  SSize_t top = av_top_index(inc_av);
+  av_extend(inc_av, top + 1);
+  for (SSize_t i = top; i >= pos; i--) {
+    SV **svp = av_fetch(inc_av, i, 0);
+    av_store(inc_av, i + 1, svp ? SvREFCNT_inc_simple_NN(*svp) : newSV(0));
+  }
+  av_store(inc_av, pos, newRV_noinc((SV *)cv));
+}
+
+//! UTF-8 validation and transcoding at the API boundary
+//!
+//! Strings from the host are validated before they get the UTF-8 flag, and
+//! pure ASCII ones are left without it. With SIMD128 (-msimd128, SIMD in
+//! build-wasm.sh) validation and ASCII runs go 16 bytes at a time: the
+//! validator is Keiser and Lemire's lookup algorithm, where three nibble
+//! table lookups classify every pair of adjacent bytes and the positions
+//! two and three bytes after a 3/4-byte lead must be exactly the expected
+//! continuations. Tails, and blocks with non-ASCII in the transcoders, take
+//! the scalar path.
+#define UTF8_TOO_SHORT 0x01
+#define UTF8_TOO_LONG 0x02
+#define UTF8_OVERLONG_3 0x04
+#define UTF8_TOO_LARGE 0x08
+#define UTF8_SURROGATE 0x10
+#define UTF8_OVERLONG_2 0x20
+#define UTF8_TOO_LARGE_1000 0x40
+#define UTF8_OVERLONG_4 0x40
+#define UTF8_TWO_CONTS 0x80
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+#define UTF8_REPLACEMENT 0xfffd
+
+//! Strict scalar validation: no overlongs, surrogates or code points past
+//! U+10FFFF. Sets *ascii when every byte is below 0x80.
+static bool zeroperl_utf8_validate_scalar(const U8 *s, size_t len, bool *ascii) {
+  size_t i = 0;
+  while (i < len) {
+    U8 c = s[i];
+    if (c < 0x80) {
+      i++;
+      continue;
+    }
+    *ascii = false;
+
+    size_t n;
+    UV cp, min;
+    if ((c & 0xe0) == 0xc0) {
+      n = 1, cp = c & 0x1f, min = 0x80;
+    } else if ((c & 0xf0) == 0xe0) {
+      n = 2, cp = c & 0x0f, min = 0x800;
+    } else if ((c & 0xf8) == 0xf0) {
+      n = 3, cp = c & 0x07, min = 0x10000;
+    } else {
+      return false;
+    }
+    if (len - i <= n) {
+      return false;
+    }
+    for (size_t k = 1; k <= n; k++) {
+      if ((s[i + k] & 0xc0) != 0x80) {
+        return false;
+      }
+      cp = (cp << 6) | (s[i + k] & 0x3f);
+    }
+    if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff)) {
+      return false;
+    }
+    i += n + 1;
+  }
+  return true;
+}
+
+//! Whether s is valid UTF-8; *ascii is set when it is also pure ASCII
+static bool zeroperl_utf8_validate(const U8 *s, size_t len, bool *ascii) {
+  size_t i = 0;
+  *ascii = true;
+
+#ifdef __wasm_simd128__
+  const v128_t byte_1_high = wasm_u8x16_const(
+      UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+      UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+      UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+      UTF8_TOO_SHORT | UTF8_OVERLONG_2, UTF8_TOO_SHORT,
+      UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+      UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+#define UTF8_LARGE (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000)
+  const v128_t byte_1_low = wasm_u8x16_const(
+      UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+      UTF8_CARRY | UTF8_OVERLONG_2, UTF8_CARRY, UTF8_CARRY,
+      UTF8_CARRY | UTF8_TOO_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE,
+      UTF8_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE,
+      UTF8_LARGE | UTF8_SURROGATE, UTF8_LARGE, UTF8_LARGE);
+#undef UTF8_LARGE
+#define UTF8_CONT (UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS)
+  const v128_t byte_2_high = wasm_u8x16_const(
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+      UTF8_CONT | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+      UTF8_CONT | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+      UTF8_CONT | UTF8_SURROGATE | UTF8_TOO_LARGE,
+      UTF8_CONT | UTF8_SURROGATE | UTF8_TOO_LARGE, UTF8_TOO_SHORT,
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+#undef UTF8_CONT
+  // Leads in the last three lanes whose sequence runs past the block
+  const v128_t incomplete_max =
+      wasm_u8x16_const(0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+                       0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf);
+  const v128_t low_nibble = wasm_u8x16_splat(0x0f);
+  v128_t prev = wasm_u8x16_splat(0);
+  v128_t prev_incomplete = prev;
+  v128_t error = prev;
+
+  for (; i + 16 <= len; i += 16) {
+    v128_t in = wasm_v128_load(s + i);
+    if (!wasm_i8x16_bitmask(in)) {
+      error = wasm_v128_or(error, prev_incomplete);
+      prev_incomplete = wasm_u8x16_splat(0);
+      prev = in;
+      continue;
+    }
+    *ascii = false;
+
+    v128_t prev1 = wasm_i8x16_shuffle(prev, in, 15, 16, 17, 18, 19, 20, 21,
+                                      22, 23, 24, 25, 26, 27, 28, 29, 30);
+    v128_t prev2 = wasm_i8x16_shuffle(prev, in, 14, 15, 16, 17, 18, 19, 20,
+                                      21, 22, 23, 24, 25, 26, 27, 28, 29);
+    v128_t prev3 = wasm_i8x16_shuffle(prev, in, 13, 14, 15, 16, 17, 18, 19,
+                                      20, 21, 22, 23, 24, 25, 26, 27, 28);
+    v128_t special = wasm_v128_and(
+        wasm_v128_and(
+            wasm_i8x16_swizzle(byte_1_high, wasm_u8x16_shr(prev1, 4)),
+            wasm_i8x16_swizzle(byte_1_low, wasm_v128_and(prev1, low_nibble))),
+        wasm_i8x16_swizzle(byte_2_high, wasm_u8x16_shr(in, 4)));
+    // Only 111_____ two back and 1111____ three back reach 0x80
+    v128_t must23 = wasm_v128_or(
+        wasm_u8x16_sub_sat(prev2, wasm_u8x16_splat(0xe0 - 0x80)),
+        wasm_u8x16_sub_sat(prev3, wasm_u8x16_splat(0xf0 - 0x80)));
+    error = wasm_v128_or(
+        error, wasm_v128_xor(
+                   wasm_v128_and(must23, wasm_u8x16_splat(0x80)), special));
+    prev_incomplete = wasm_u8x16_sub_sat(in, incomplete_max);
+    prev = in;
+  }
+
+  if (wasm_v128_any_true(error)) {
+    return false;
+  }
+
+  // Rescan from the lead of a sequence that may continue into the tail
+  size_t back = 0;
+  while (i > 0 && back < 3 && (s[i - 1] & 0xc0) == 0x80) {
+    i--, back++;
+  }
+  if (i > 0 && s[i - 1] >= 0xc0) {
+    i--;
+  }
+#else
+  // ASCII eight bytes at a time
+  for (; i + 8 <= len; i += 8) {
+    uint64_t word;
+    memcpy(&word, s + i, 8);
+    if (word & 0x8080808080808080ULL) {
+      break;
+    }
+  }
+#endif
+
+  return zeroperl_utf8_validate_scalar(s + i, len - i, ascii);
+}
+
+//! Number of bytes at or above 0x80, i.e. the growth from Latin-1 to UTF-8
+static size_t zeroperl_latin1_utf8_extra(const U8 *s, size_t len) {
+  size_t extra = 0, i = 0;
+#ifdef __wasm_simd128__
+  for (; i + 16 <= len; i += 16) {
+    extra += __builtin_popcount(wasm_i8x16_bitmask(wasm_v128_load(s + i)));
+  }
+#endif
+  for (; i < len; i++) {
+    extra += s[i] >> 7;
+  }
+  return extra;
+}
+
+//! Latin-1 to UTF-8; d needs len + zeroperl_latin1_utf8_extra(s, len) bytes
+static void zeroperl_latin1_to_utf8(const U8 *s, size_t len, U8 *d) {
+  size_t i = 0;
+  while (i < len) {
+#ifdef __wasm_simd128__
+    if (i + 16 <= len) {
+      v128_t in = wasm_v128_load(s + i);
+      if (!wasm_i8x16_bitmask(in)) {
+        wasm_v128_store(d, in);
+        d += 16, i += 16;
+        continue;
+      }
+    }
+#endif
+    U8 c = s[i++];
+    if (c < 0x80) {
+      *d++ = c;
+    } else {
+      *d++ = 0xc0 | (c >> 6);
+      *d++ = 0x80 | (c & 0x3f);
+    }
+  }
+}
+
+//! UTF-16 to UTF-8, unpaired surrogates becoming U+FFFD as in TextEncoder;
+//! d needs 3 bytes per unit. Returns the bytes written and clears *ascii
+//! if any unit is not ASCII.
+static size_t zeroperl_utf16_to_utf8(const uint16_t *s, size_t len, U8 *d,
+                            bool *ascii) {
+  U8 *start = d;
+  size_t i = 0;
+  *ascii = true;
+  while (i < len) {
+#ifdef __wasm_simd128__
+    if (i + 16 <= len) {
+      v128_t lo = wasm_v128_load(s + i);
+      v128_t hi = wasm_v128_load(s + i + 8);
+      if (!wasm_v128_any_true(wasm_v128_and(wasm_v128_or(lo, hi),
+                                            wasm_u16x8_splat(0xff80)))) {
+        wasm_v128_store(d, wasm_u8x16_narrow_i16x8(lo, hi));
+        d += 16, i += 16;
+        continue;
+      }
+    }
+#endif
+    UV cp = s[i++];
+    if (cp < 0x80) {
+      *d++ = (U8)cp;
+      continue;
+    }
+    *ascii = false;
+    if (cp >= 0xd800 && cp <= 0xdbff && i < len && s[i] >= 0xdc00 &&
+        s[i] <= 0xdfff) {
+      cp = 0x10000 + ((cp - 0xd800) << 10) + (s[i++] - 0xdc00);
+    } else if (cp >= 0xd800 && cp <= 0xdfff) {
+      cp = UTF8_REPLACEMENT;
+    }
+    if (cp < 0x800) {
+      *d++ = 0xc0 | (cp >> 6);
+    } else if (cp < 0x10000) {
+      *d++ = 0xe0 | (cp >> 12);
+      *d++ = 0x80 | ((cp >> 6) & 0x3f);
+    } else {
+      *d++ = 0xf0 | (cp >> 18);
+      *d++ = 0x80 | ((cp >> 12) & 0x3f);
+      *d++ = 0x80 | ((cp >> 6) & 0x3f);
+    }
+    *d++ = 0x80 | (cp & 0x3f);
+  }
+  return d - start;
+}
+
+//! UTF-8 (Perl's, so possibly malformed) or Latin-1 to UTF-16
+//!
+//! Counts the units without writing when d is NULL. Malformed bytes and
+//! code points past U+10FFFF become U+FFFD; surrogate code points pass
+//! through as lone units, which JavaScript strings allow.
+static size_t zeroperl_perl_to_utf16(const U8 *s, size_t len, bool utf8,
+                            uint16_t *d) {
+  size_t units = 0, i = 0;
+  while (i < len) {
+#ifdef __wasm_simd128__
+    if (i + 16 <= len) {
+      v128_t in = wasm_v128_load(s + i);
+      if (!utf8 || !wasm_i8x16_bitmask(in)) {
+        if (d) {
+          wasm_v128_store(d + units, wasm_u16x8_extend_low_u8x16(in));
+          wasm_v128_store(d + units + 8, wasm_u16x8_extend_high_u8x16(in));
+        }
+        units += 16, i += 16;
+        continue;
+      }
+    }
+#endif
+    UV cp = s[i++];
+    if (utf8 && cp >= 0x80) {
+      size_t n = 0;
+      UV min = 0;
+      if ((cp & 0xe0) == 0xc0) {
+        n = 1, cp &= 0x1f, min = 0x80;
+      } else if ((cp & 0xf0) == 0xe0) {
+        n = 2, cp &= 0x0f, min = 0x800;
+      } else if ((cp & 0xf8) == 0xf0) {
+        n = 3, cp &= 0x07, min = 0x10000;
+      }
+      size_t k = 0;
+      while (k < n && i + k < len && (s[i + k] & 0xc0) == 0x80) {
+        cp = (cp << 6) | (s[i + k] & 0x3f);
+        k++;
+      }
+      if (n == 0 || k < n || cp < min || cp > 0x10ffff) {
+        cp = UTF8_REPLACEMENT;
+      }
+      i += k;
+    }
+    if (cp >= 0x10000) {
+      if (d) {
+        d[units] = 0xd800 + ((cp - 0x10000) >> 10);
+        d[units + 1] = 0xdc00 + ((cp - 0x10000) & 0x3ff);
+      }
+      units += 2;
+    } else {
+      if (d) {
+        d[units] = (uint16_t)cp;
+      }
+      units++;
+    }
+  }
+  return units;
+}
+
+//! New scalar from host UTF-8, flagged only if it is not pure ASCII.
+//! Returns NULL if str is not valid UTF-8.
+static SV *zeroperl_new_utf8_sv(pTHX_ const char *str, size_t len) {
+  bool ascii;
+  if (!zeroperl_utf8_validate((const U8 *)str, len, &ascii)) {
+    return NULL;
+  }
+  return newSVpvn_flags(str, len, ascii ? 0 : SVf_UTF8);
+}
+
+//! Upgrades a non-ASCII byte string to UTF-8 in place, as SvPVutf8 would
+static void zeroperl_sv_upgrade_latin1(pTHX_ SV *sv) {
+  const U8 *s = (const U8 *)SvPVX_const(sv);
+  STRLEN len = SvCUR(sv);
+  STRLEN out_len = len + zeroperl_latin1_utf8_extra(s, len);
+  char *buf;
+  Newx(buf, out_len + 1, char);
+  zeroperl_latin1_to_utf8(s, len, (U8 *)buf);
+  buf[out_len] = '\0';
+  sv_usepvn_flags(sv, buf, out_len, SV_HAS_TRAILING_NUL);
+  SvUTF8_on(sv);
+}
+
+//! Opaque handle to a Perl scalar value
+typedef struct zeroperl_value_s {
+  SV *sv;
+} zeroperl_value;
+
+//! Opaque handle to a Perl array
+typedef struct zeroperl_array_s {
+  AV *av;
+} zeroperl_array;
+
+//! Opaque handle to a Perl hash
+typedef struct zeroperl_hash_s {
+  HV *hv;
+} zeroperl_hash;
+
+//! Opaque handle to a Perl code reference
+typedef struct zeroperl_code_s {
+  CV *cv;
+} zeroperl_code;
+
+//! Result structure for operations that return multiple values
+typedef struct zeroperl_result_s {
+  int count;
+  zeroperl_value **values;
+} zeroperl_result;
+
+//! Iterator for hash traversal
+typedef struct zeroperl_hash_iter_s {
+  HV *hv;
+  HE *entry;
+} zeroperl_hash_iter;
+
+//! Prehashed hash key (zeroperl_key_intern)
+//!
+//! A shared-string scalar: it holds a reference on the key's entry in Perl's
+//! shared string table, and that entry carries the precomputed hash. The
+//! hv_*_ent calls take the hash from it and, in hashes with shared keys
+//! (the default), match entries by HEK pointer before comparing bytes.
+typedef struct zeroperl_key_s {
+  SV *sv;
+} zeroperl_key;
+
+//! Handle scopes (zeroperl_scope_begin/zeroperl_scope_end)
+//!
+//! zeroperl_value, zeroperl_array, zeroperl_hash and zeroperl_key are all a
+//! single SV-compatible pointer. Inside a scope they are bumped from chunks
+//! of such slots instead of malloc'd one at a time, and scope end drops every
+//! reference taken since the matching begin in one pass. Chunks stay
+//! allocated for the next scope.
+//!
+//! Each chunk is aligned to its own size, so the chunk-sized region of the
+//! 32-bit address space a pointer falls in tells whether it is a scoped
+//! handle: one bit per region, set when a chunk is allocated there.
+#ifndef HANDLE_CHUNK_SLOTS
+#define HANDLE_CHUNK_SLOTS 4096
+#endif
+#if HANDLE_CHUNK_SLOTS & (HANDLE_CHUNK_SLOTS - 1)
+#error "HANDLE_CHUNK_SLOTS must be a power of two"
+#endif
+#define HANDLE_CHUNK_BYTES (sizeof(SV *) * HANDLE_CHUNK_SLOTS)
+
+#ifndef MAX_HANDLE_SCOPES
+#define MAX_HANDLE_SCOPES 64
+#endif
+
+static SV ***handle_chunks = NULL;
+static size_t handle_chunk_count = 0;
+static size_t handle_top = 0;
+static size_t handle_scope_marks[MAX_HANDLE_SCOPES];
+static int handle_scope_depth = 0;
+static uint32_t
+    handle_chunk_map[((uint64_t)1 << 32) / HANDLE_CHUNK_BYTES / 32];
+
+//! Allocates a handle: from the innermost scope if one is open, else malloc
+static void *zeroperl_handle_alloc(void) {
+  if (handle_scope_depth == 0) {
+    return malloc(sizeof(SV *));
+  }
+
+  size_t chunk = handle_top / HANDLE_CHUNK_SLOTS;
+  if (chunk == handle_chunk_count) {
+    SV ***chunks = (SV ***)realloc(handle_chunks,
+                                   sizeof(SV **) * (handle_chunk_count + 1));
+    if (!chunks) {
+      return NULL;
+    }
+    handle_chunks = chunks;
+    handle_chunks[chunk] =
+        (SV **)aligned_alloc(HANDLE_CHUNK_BYTES, HANDLE_CHUNK_BYTES);
+    if (!handle_chunks[chunk]) {
+      return NULL;
+    }
+    size_t region = (uintptr_t)handle_chunks[chunk] / HANDLE_CHUNK_BYTES;
+    handle_chunk_map[region / 32] |= (uint32_t)1 << (region % 32);
+    handle_chunk_count++;
+  }
+
+  SV **slot = &handle_chunks[chunk][handle_top++ % HANDLE_CHUNK_SLOTS];
+  *slot = NULL;
+  return slot;
+}
+
+//! Whether a handle lives in a scope chunk
+static bool zeroperl_handle_scoped(const void *handle) {
+  uint64_t region = (uintptr_t)handle / HANDLE_CHUNK_BYTES;
+  if (region >= sizeof(handle_chunk_map) * 8) {
+    return false;
+  }
+  return (handle_chunk_map[region / 32] >> (region % 32)) & 1;
+}
+
+//! Releases a handle whose reference has already been dropped: a scoped
+//! one is cleared so scope end skips it, any other is freed
+static void zeroperl_handle_free(void *handle) {
+  if (zeroperl_handle_scoped(handle)) {
+    *(SV **)handle = NULL;
+  } else {
+    free(handle);
+  }
+}
+
+//! Drops the references held by handles above mark, clearing each slot
+static void zeroperl_handles_release(size_t mark) {
+  while (handle_top > mark) {
+    handle_top--;
+    SV **slot = &handle_chunks[handle_top / HANDLE_CHUNK_SLOTS]
+                              [handle_top % HANDLE_CHUNK_SLOTS];
+    SV *sv = *slot;
+    *slot = NULL;
+    if (sv && zero_perl) {
+      dTHX;
+      SvREFCNT_dec(sv);
+    }
+  }
+}
+
+//! Ends every open scope, before the interpreter is destructed
+static void zeroperl_scopes_end_all(void) {
+  zeroperl_handles_release(0);
+  handle_scope_depth = 0;
+}
+
+//! Shared string buffers (zeroperl_new_string_shared)
+//!
+//! A shared scalar points straight at host memory: SvLEN is 0 so Perl never
+//! frees or reallocates the buffer, and it is read-only so it is never
+//! written. Ext magic carries the release callback, which runs when the
+//! scalar is freed. Interpreter teardown at destruct level 0 does not free
+//! every scalar, so live buffers are also kept on a list and released after
+//! perl_destruct.
+typedef enum {
+  ZEROPERL_SHARED_BYTES = 0,
+  ZEROPERL_SHARED_UTF8 = 1,
+  ZEROPERL_SHARED_FREE = 2
+} zeroperl_shared_flags;
+
+typedef void (*zeroperl_release_fn)(void *ctx, const char *ptr, size_t len);
+
+typedef struct zeroperl_shared_s {
+  const char *ptr;
+  size_t len;
+  int flags;
+  zeroperl_release_fn release;
+  void *ctx;
+  struct zeroperl_shared_s *prev;
+  struct zeroperl_shared_s *next;
+} zeroperl_shared;
+
+static zeroperl_shared *shared_live = NULL;
+
+static void zeroperl_shared_release(zeroperl_shared *shared) {
+  if (shared->prev) {
+    shared->prev->next = shared->next;
+  } else {
+    shared_live = shared->next;
+  }
+  if (shared->next) {
+    shared->next->prev = shared->prev;
+  }
+
+  if (shared->release) {
+    shared->release(shared->ctx, shared->ptr, shared->len);
+  }
+  if (shared->flags & ZEROPERL_SHARED_FREE) {
+    free((void *)shared->ptr);
+  }
+  free(shared);
+}
+
+static int zeroperl_shared_mg_free(pTHX_ SV *sv, MAGIC *mg) {
+  PERL_UNUSED_ARG(sv);
+  zeroperl_shared *shared = (zeroperl_shared *)mg->mg_ptr;
+  if (shared) {
+    mg->mg_ptr = NULL;
+    zeroperl_shared_release(shared);
+  }
+  return 0;
+}
+
+static MGVTBL zeroperl_shared_vtbl = {
+    NULL, NULL, NULL, NULL, zeroperl_shared_mg_free, NULL, NULL, NULL};
+
+//! Releases the buffers of scalars perl_destruct left behind
+static void zeroperl_shared_release_all(void) {
+  while (shared_live) {
+    zeroperl_shared_release(shared_live);
+  }
+}
+
+//! Context type for calling Perl code
+typedef enum {
+  ZEROPERL_VOID,
+  ZEROPERL_SCALAR,
+  ZEROPERL_LIST
+} zeroperl_context_type;
+
+//! Value type enumeration
+typedef enum {
+  ZEROPERL_TYPE_UNDEF,
+  ZEROPERL_TYPE_TRUE,
+  ZEROPERL_TYPE_FALSE,
+  ZEROPERL_TYPE_INT,
+  ZEROPERL_TYPE_DOUBLE,
+  ZEROPERL_TYPE_STRING,
+  ZEROPERL_TYPE_ARRAY,
+  ZEROPERL_TYPE_HASH,
+  ZEROPERL_TYPE_CODE,
+  ZEROPERL_TYPE_REF
+} zeroperl_type;
+
+//! Operation type for unified context
+typedef enum {
+  ZEROPERL_OP_INIT,
+  ZEROPERL_OP_EVAL,
+  ZEROPERL_OP_RUN_FILE,
+  ZEROPERL_OP_RESET,
+  ZEROPERL_OP_CALL,
+  ZEROPERL_OP_COMPILE
+} zeroperl_op_type;
 
 //! Unified context structure for all Perl operations
 typedef struct {
@@ -543,19 +2050,47 @@ typedef struct {
       char **argv;
     } run_file;
     struct {
-      const char *name;
+      const char *name; // sub to call by name, unless sv is set
+      SV *sv;           // CV to call directly
       int argc;
       zeroperl_value **argv;
+      char **strv; // string arguments, used instead of argv when set
       zeroperl_context_type context;
     } call;
+    struct {
+      const char *code;
+      zeroperl_code *out;
+    } compile;
   } data;
 } zeroperl_context;
 
 //! Host-implemented function for calling back into the host environment
+//!
+//! Listed in the Asyncify imports, so the host may suspend in it.
 ZEROPERL_IMPORT("call_host_function")
 zeroperl_value *host_call_function(int32_t func_id, int32_t argc,
                                    zeroperl_value **argv);
 
+//! Same as call_host_function, for functions registered ZEROPERL_HOST_SYNC
+//!
+//! Not an Asyncify import: the host must return without suspending, and the
+//! call is not an unwind point, so Asyncify adds no state saving around it.
+//! The callers stay instrumented where they can croak or free a value.
+ZEROPERL_IMPORT("call_host_function_sync")
+zeroperl_value *host_call_function_sync(int32_t func_id, int32_t argc,
+                                        zeroperl_value **argv);
+
+//! Typed variants, for functions registered with a signature
+//!
+//! frame holds one 8-byte slot per argument, already converted, followed by
+//! the slot the host writes the result into (see
+//! zeroperl_register_function_ex).
+ZEROPERL_IMPORT("call_host_function_typed")
+void host_call_function_typed(int32_t func_id, void *frame);
+
+ZEROPERL_IMPORT("call_host_function_typed_sync")
+void host_call_function_typed_sync(int32_t func_id, void *frame);
+
 // Import functions from JavaScript for async operations
 ZEROPERL_IMPORT("js_async_fetch")
 int32_t js_async_fetch(const char *url, const char *method, const char *headers, const char *body);
@@ -566,20 +2101,52 @@ int32_t js_async_timer(int32_t delay_ms);
 ZEROPERL_IMPORT("js_async_resolve_pending")
 bool js_async_resolve_pending(void);
 
+//! Flags for zeroperl_register_function_ex() and zeroperl_register_method_ex()
+typedef enum {
+  ZEROPERL_HOST_SUSPENDING = 0, // called through call_host_function
+  ZEROPERL_HOST_SYNC = 1        // called through call_host_function_sync
+} zeroperl_host_flags;
+
 //! Registry for host function IDs
 typedef struct {
   int32_t func_id;
   char *name;
   char *package;
   bool is_method;
+  bool is_sync;
+  char *arg_types; // typed functions: one of "ilds" per argument, else NULL
+  int nargs;
+  char ret_type;   // 'i', 'l', 'd', 's' or 'v'
 } host_function_entry;
 
 #ifndef MAX_HOST_FUNCTIONS
 #define MAX_HOST_FUNCTIONS 256
 #endif
 
-static host_function_entry host_functions[MAX_HOST_FUNCTIONS];
-static int host_function_count = 0;
+static host_function_entry host_functions[MAX_HOST_FUNCTIONS];
+static int host_function_count = 0;
+
+//! Argument frames for host calls
+//!
+//! Each host call takes items + 1 slots off the top of this arena: one
+//! zeroperl_value per argument, holding the SV from the Perl stack as is, and
+//! a return slot. Nested calls (host -> Perl -> host) stack on top; a call
+//! that does not fit falls back to the heap.
+//!
+//! The build has no MULTIPLICITY: zero_perl is the only interpreter in the
+//! instance, so these arenas are its per-interpreter state like PL_* are.
+#ifndef HOST_FRAME_SLOTS
+#define HOST_FRAME_SLOTS 1024
+#endif
+
+static zeroperl_value host_frame_values[HOST_FRAME_SLOTS];
+static zeroperl_value *host_frame_argv[HOST_FRAME_SLOTS];
+static size_t host_frame_top = 0;
+static zeroperl_value *host_frame_ret = NULL;
+
+//! Same for typed host calls: items + 1 raw 8-byte slots per call
+static uint64_t host_typed_slots[HOST_FRAME_SLOTS];
+static size_t host_typed_top = 0;
 
 //! Captures the current Perl error ($@) into the error buffer
 static void zeroperl_capture_error(void) {
@@ -624,39 +2191,145 @@ const char *zeroperl_get_host_error(void) { return host_error_buf; }
 ZEROPERL_API("zeroperl_clear_host_error")
 void zeroperl_clear_host_error(void) { host_error_buf[0] = '\0'; }
 
-//! XS callback that dispatches to host functions
-static XS(xs_host_dispatch) {
-  dXSARGS;
+//! Stores sv as the result of the host call in progress
+static zeroperl_value *zeroperl_host_return_sv(pTHX_ SV *sv) {
+  host_frame_ret->sv = sv_2mortal(sv);
+  return host_frame_ret;
+}
 
-  int32_t func_id = (int32_t)CvXSUBANY(cv).any_i32;
+//! Return an integer from the host function in progress
+//!
+//! The zeroperl_host_return_* functions fill the call's preallocated return
+//! slot and return it; the host function returns that pointer in place of a
+//! value from zeroperl_new_*, and nothing is allocated or freed. They return
+//! NULL outside a host call.
+ZEROPERL_API("zeroperl_host_return_int")
+zeroperl_value *zeroperl_host_return_int(int32_t i) {
+  if (!host_frame_ret) {
+    return NULL;
+  }
 
-  zeroperl_clear_host_error();
+  dTHX;
+  return zeroperl_host_return_sv(aTHX_ newSViv(i));
+}
 
-  zeroperl_value **argv = NULL;
-  if (items > 0) {
-    argv = (zeroperl_value **)malloc(sizeof(zeroperl_value *) * items);
-    for (int i = 0; i < items; i++) {
-      argv[i] = (zeroperl_value *)malloc(sizeof(zeroperl_value));
-      argv[i]->sv = ST(i);
-      SvREFCNT_inc(argv[i]->sv);
-    }
+//! Return a double from the host function in progress
+ZEROPERL_API("zeroperl_host_return_double")
+zeroperl_value *zeroperl_host_return_double(double d) {
+  if (!host_frame_ret) {
+    return NULL;
+  }
+
+  dTHX;
+  return zeroperl_host_return_sv(aTHX_ newSVnv(d));
+}
+
+//! Return a boolean from the host function in progress
+ZEROPERL_API("zeroperl_host_return_bool")
+zeroperl_value *zeroperl_host_return_bool(bool b) {
+  if (!host_frame_ret) {
+    return NULL;
   }
 
-  zeroperl_value *result = host_call_function(func_id, items, argv);
+  dTHX;
+  SV *sv = b ? &PL_sv_yes : &PL_sv_no;
+  return zeroperl_host_return_sv(aTHX_ SvREFCNT_inc_simple_NN(sv));
+}
 
-  if (argv) {
-    for (int i = 0; i < items; i++) {
-      SvREFCNT_dec(argv[i]->sv);
-      free(argv[i]);
-    }
-    free(argv);
+//! Return a UTF-8 string from the host function in progress
+//!
+//! Returns NULL if str is not valid UTF-8.
+ZEROPERL_API("zeroperl_host_return_string")
+zeroperl_value *zeroperl_host_return_string(const char *str, size_t len) {
+  if (!host_frame_ret || (!str && len > 0)) {
+    return NULL;
+  }
+
+  dTHX;
+  SV *sv = zeroperl_new_utf8_sv(aTHX_ str ? str : "", len);
+  if (!sv) {
+    return NULL;
+  }
+  return zeroperl_host_return_sv(aTHX_ sv);
+}
+
+//! Return an existing value from the host function in progress
+//!
+//! val stays owned by the caller.
+ZEROPERL_API("zeroperl_host_return_value")
+zeroperl_value *zeroperl_host_return_value(zeroperl_value *val) {
+  if (!host_frame_ret || !val || !val->sv) {
+    return NULL;
   }
 
-  if (!result || !result->sv) {
-    if (result) {
+  dTHX;
+  return zeroperl_host_return_sv(aTHX_ SvREFCNT_inc_simple_NN(val->sv));
+}
+
+//! Body of the host dispatch XSUBs
+//!
+//! Always inlined with a constant sync, so the sync XSUB contains no call to
+//! the suspending import. Asyncify still instruments it, as croak and
+//! SvREFCNT_dec (through DESTROY) can longjmp, but the host call itself is
+//! not an unwind point.
+static inline __attribute__((always_inline)) void
+host_dispatch(pTHX_ CV *cv, bool sync) {
+  dXSARGS;
+
+  int32_t func_id = (int32_t)CvXSUBANY(cv).any_i32;
+
+  zeroperl_clear_host_error();
+
+  // Arguments are borrowed from the Perl stack for the duration of the call.
+  // A die from Perl code the host calls back into skips the restores below,
+  // so the save stack puts back the arena top and return slot
+  size_t base = host_frame_top;
+  size_t slots = (size_t)items + 1;
+  zeroperl_value *values;
+  zeroperl_value **argv;
+  if (slots > HOST_FRAME_SLOTS - base) {
+    Newx(values, slots, zeroperl_value);
+    SAVEFREEPV(values);
+    Newx(argv, slots, zeroperl_value *);
+    SAVEFREEPV(argv);
+  } else {
+    values = &host_frame_values[base];
+    argv = &host_frame_argv[base];
+    SAVESTRLEN(host_frame_top);
+    host_frame_top = base + slots;
+  }
+
+  for (int i = 0; i < items; i++) {
+    values[i].sv = ST(i);
+    argv[i] = &values[i];
+  }
+  zeroperl_value *ret = &values[items];
+  ret->sv = NULL;
+
+  zeroperl_value *outer_ret = host_frame_ret;
+  SAVEVPTR(host_frame_ret);
+  host_frame_ret = ret;
+  zeroperl_value *result =
+      sync ? host_call_function_sync(func_id, items, items > 0 ? argv : NULL)
+           : host_call_function(func_id, items, items > 0 ? argv : NULL);
+  host_frame_ret = outer_ret;
+  host_frame_top = base;
+
+  // Either the return slot, already mortal, or a value from zeroperl_new_*
+  SV *sv = NULL;
+  if (result == ret) {
+    sv = ret->sv;
+  } else if (result) {
+    if (result->sv) {
+      sv = sv_2mortal(SvREFCNT_inc_simple_NN(result->sv));
+    }
+    // A scoped handle stays with its scope, which drops its reference
+    if (!zeroperl_handle_scoped(result)) {
       free(result);
     }
+  }
 
+  if (!sv) {
     const char *host_err = zeroperl_get_host_error();
     if (host_err && host_err[0] != '\0') {
       croak("%s", host_err);
@@ -665,13 +2338,163 @@ static XS(xs_host_dispatch) {
     XSRETURN_UNDEF;
   }
 
-  SV *sv = result->sv;
-  SvREFCNT_inc(sv);
-  free(result);
-  ST(0) = sv_2mortal(sv);
+  ST(0) = sv;
+  XSRETURN(1);
+}
+
+//! XS callback that dispatches to host functions
+static XS(xs_host_dispatch) { host_dispatch(aTHX_ cv, false); }
+
+//! XS callback that dispatches to synchronous host functions
+static XS(xs_host_dispatch_sync) { host_dispatch(aTHX_ cv, true); }
+
+//! String value of sv as UTF-8
+//!
+//! Points into sv's own buffer unless sv holds non-ASCII bytes without the
+//! UTF-8 flag; those are upgraded in a mortal copy, leaving sv as it was.
+static const char *zeroperl_sv_utf8(pTHX_ SV *sv, STRLEN *len) {
+  const char *p = SvPV_const(sv, *len);
+  if (SvUTF8(sv)) {
+    return p;
+  }
+
+  STRLEN extra = zeroperl_latin1_utf8_extra((const U8 *)p, *len);
+  if (extra) {
+    SV *tmp = sv_2mortal(newSV(*len + extra));
+    zeroperl_latin1_to_utf8((const U8 *)p, *len, (U8 *)SvPVX(tmp));
+    *len += extra;
+    p = SvPVX(tmp);
+  }
+  return p;
+}
+
+//! Body of the typed host dispatch XSUBs
+//!
+//! Converts each argument as the signature says and stores it in its slot:
+//! i as an int32, l as an int64, d as a double and s as a UTF-8 (ptr, len)
+//! pair of uint32s. The result slot is read back the same way; for s the
+//! host passes ownership of a malloc'd buffer, or a NULL ptr for undef; a
+//! string that is not valid UTF-8 dies.
+static inline __attribute__((always_inline)) void
+host_dispatch_typed(pTHX_ CV *cv, bool sync) {
+  dXSARGS;
+
+  const host_function_entry *entry =
+      (const host_function_entry *)CvXSUBANY(cv).any_ptr;
+  if (items != entry->nargs) {
+    croak("%s expects %d argument%s, got %d", entry->name, entry->nargs,
+          entry->nargs == 1 ? "" : "s", (int)items);
+  }
+
+  zeroperl_clear_host_error();
+
+  // Argument conversion can run magic, and so Perl code that dies; the save
+  // stack then releases the frame
+  size_t base = host_typed_top;
+  size_t slots = (size_t)items + 1;
+  uint64_t *frame;
+  if (slots > HOST_FRAME_SLOTS - base) {
+    Newx(frame, slots, uint64_t);
+    SAVEFREEPV(frame);
+  } else {
+    frame = &host_typed_slots[base];
+    SAVESTRLEN(host_typed_top);
+    host_typed_top = base + slots;
+  }
+
+  for (int i = 0; i < items; i++) {
+    SV *sv = ST(i);
+    switch (entry->arg_types[i]) {
+    case 'i': {
+      int32_t v = (int32_t)SvIV(sv);
+      memcpy(&frame[i], &v, sizeof(v));
+      break;
+    }
+    case 'l': {
+      int64_t v = (int64_t)SvIV(sv);
+      memcpy(&frame[i], &v, sizeof(v));
+      break;
+    }
+    case 'd': {
+      double v = (double)SvNV(sv);
+      memcpy(&frame[i], &v, sizeof(v));
+      break;
+    }
+    default: {
+      STRLEN len;
+      const char *p = zeroperl_sv_utf8(aTHX_ sv, &len);
+      uint32_t v[2] = {(uint32_t)(uintptr_t)p, (uint32_t)len};
+      memcpy(&frame[i], v, sizeof(v));
+      break;
+    }
+    }
+  }
+  frame[items] = 0;
+
+  if (sync) {
+    host_call_function_typed_sync(entry->func_id, frame);
+  } else {
+    host_call_function_typed(entry->func_id, frame);
+  }
+  host_typed_top = base;
+
+  SV *ret = NULL;
+  switch (entry->ret_type) {
+  case 'i': {
+    int32_t v;
+    memcpy(&v, &frame[items], sizeof(v));
+    ret = sv_2mortal(newSViv(v));
+    break;
+  }
+  case 'l': {
+    int64_t v;
+    memcpy(&v, &frame[items], sizeof(v));
+    ret = sv_2mortal(newSViv((IV)v));
+    break;
+  }
+  case 'd': {
+    double v;
+    memcpy(&v, &frame[items], sizeof(v));
+    ret = sv_2mortal(newSVnv(v));
+    break;
+  }
+  case 's': {
+    uint32_t v[2];
+    memcpy(v, &frame[items], sizeof(v));
+    char *p = (char *)(uintptr_t)v[0];
+    if (p) {
+      ret = zeroperl_new_utf8_sv(aTHX_ p, v[1]);
+      free(p);
+      if (!ret) {
+        croak("%s returned a string that is not valid UTF-8", entry->name);
+      }
+      sv_2mortal(ret);
+    }
+    break;
+  }
+  }
+
+  const char *host_err = zeroperl_get_host_error();
+  if (host_err[0] != '\0') {
+    croak("%s", host_err);
+  }
+
+  if (!ret) {
+    XSRETURN_UNDEF;
+  }
+
+  ST(0) = ret;
   XSRETURN(1);
 }
 
+//! XS callback that dispatches to typed host functions
+static XS(xs_host_dispatch_typed) { host_dispatch_typed(aTHX_ cv, false); }
+
+//! XS callback that dispatches to typed synchronous host functions
+static XS(xs_host_dispatch_typed_sync) {
+  host_dispatch_typed(aTHX_ cv, true);
+}
+
 //! Internal callback for initialization
 static int zeroperl_init_callback(int argc, char **argv) {
   (void)argc;
@@ -904,7 +2727,9 @@ static int zeroperl_reset_callback(int argc, char **argv) {
     return -1;
   }
 
+  zeroperl_scopes_end_all();
   perl_destruct(zero_perl);
+  zeroperl_shared_release_all();
   perl_construct(zero_perl);
 
   PL_perl_destruct_level = 0;
@@ -944,6 +2769,214 @@ static int zeroperl_reset_callback(int argc, char **argv) {
   return 0;
 }
 
+//! An operation callback and its context, as run by zeroperl_run()
+typedef struct {
+  int (*callback)(int argc, char **argv);
+  zeroperl_context *ctx;
+  JMPENV *env;
+  I32 oldscope; // PL_scopestack_ix when the JMPENV was entered
+  int status;
+} zeroperl_entry;
+
+#ifdef ASYNCJMP_TRY_CATCH
+static void zeroperl_entry_try(void *p) {
+  zeroperl_entry *entry = (zeroperl_entry *)p;
+  entry->status = entry->callback(0, (char **)entry->ctx);
+}
+
+//! Perl jumped past all of its own JMPENVs: exit(), or a die with no eval
+//! to catch it. my_exit_jump() has already unwound the context stack, so the
+//! callback's frame is abandoned and the call fails (or, for eval and
+//! run_file, returns the exit status). Scopes the callback entered outside
+//! any context (its ENTER/SAVETMPS) are left here, as perl_run() does.
+static void zeroperl_entry_catch(void *p) {
+  zeroperl_entry *entry = (zeroperl_entry *)p;
+  dTHX;
+  int ret;
+
+  JMPENV_CAUGHT(*entry->env, ret);
+  (void)ret;
+
+  int status = STATUS_EXIT;
+  zeroperl_capture_error();
+  if (status != 0 && zero_perl_error_buf[0] == '\0') {
+    snprintf(zero_perl_error_buf, sizeof(zero_perl_error_buf),
+             "Perl exited with status %d", status);
+  }
+
+  while (PL_scopestack_ix > entry->oldscope) {
+    LEAVE;
+  }
+  FREETMPS;
+
+  // No host call is live outside the outermost entry
+  host_frame_top = 0;
+  host_frame_ret = NULL;
+  host_typed_top = 0;
+
+  bool has_status = entry->ctx->op_type == ZEROPERL_OP_EVAL ||
+                    entry->ctx->op_type == ZEROPERL_OP_RUN_FILE;
+  entry->ctx->result = has_status ? status : -1;
+  entry->status = entry->ctx->result;
+}
+#endif
+
+static int zeroperl_entry_callback(int argc, char **argv) {
+  zeroperl_entry *entry = (zeroperl_entry *)argv;
+
+#ifdef ASYNCJMP_TRY_CATCH
+  dTHX;
+  if (PL_top_env == &PL_start_env) {
+    struct asyncjmp_try_catch tc;
+    dJMPENV;
+
+    entry->env = &cur_env;
+    entry->oldscope = PL_scopestack_ix;
+    JMPENV_RUN(tc, zeroperl_entry_try, zeroperl_entry_catch, entry);
+    JMPENV_POP;
+    return entry->status;
+  }
+#endif
+
+  return entry->callback(argc, (char **)entry->ctx);
+}
+
+//! Runs an operation on a live interpreter from the Asyncify root frame
+//!
+//! The outermost call (not one re-entered from a host function) runs under
+//! a JMPENV entered through asyncjmp_try_catch_loop_run(), so a longjmp
+//! that escapes Perl lands there instead of terminating the instance.
+static int zeroperl_run(int (*callback)(int argc, char **argv),
+                        zeroperl_context *ctx) {
+  zeroperl_entry entry = {.callback = callback, .ctx = ctx};
+  return asyncjmp_rt_start(zeroperl_entry_callback, 0, (char **)&entry);
+}
+
+#ifdef USE_HASH_SEED
+//! Puts every entry of a hash back in the bucket its current hash selects
+static void zeroperl_rebucket(pTHX_ HV *hv) {
+  HE **array = HvARRAY(hv);
+  STRLEN max = HvMAX(hv);
+  HE *all = NULL;
+
+  for (STRLEN i = 0; i <= max; i++) {
+    HE *he = array[i];
+    while (he) {
+      HE *next = HeNEXT(he);
+      HeNEXT(he) = all;
+      all = he;
+      he = next;
+    }
+    array[i] = NULL;
+  }
+  while (all) {
+    HE *next = HeNEXT(all);
+    HE **slot = &array[HeHASH(all) & max];
+    HeNEXT(all) = *slot;
+    *slot = all;
+    all = next;
+  }
+
+  // A pending each() would resume at the wrong bucket
+  if (!SvRMAGICAL(hv) && HvRITER_get(hv) != -1) {
+    hv_iterinit(hv);
+  }
+}
+
+//! Gives this instance its own hash seed after a build-time
+//! pre-initialization
+//!
+//! The snapshot holds the seed Perl drew at build time, which every instance
+//! would otherwise share, defeating hash-flooding protection. A new seed
+//! changes the hash of every key already stored, so all HEKs are rehashed:
+//! PL_strtab owns the shared ones and hashes without shared keys own the
+//! rest. Every hash is then rebucketed from the new values.
+static void zeroperl_reseed_hashes(pTHX) {
+  // Honours PERL_HASH_SEED and PERL_PERTURB_KEYS; without a fixed seed, mix
+  // in host entropy, as WASI has no /dev/urandom for Perl's own seed()
+  Perl_get_hash_seed(aTHX_ PL_hash_seed);
+  if (!getenv("PERL_HASH_SEED")) {
+    U8 entropy[PERL_HASH_SEED_BYTES + sizeof(UV)];
+    if (__wasi_random_get(entropy, sizeof(entropy)) == 0) {
+      for (size_t i = 0; i < PERL_HASH_SEED_BYTES; i++) {
+        PL_hash_seed[i] ^= entropy[i];
+      }
+      if (PL_HASH_RAND_BITS_ENABLED == 1) {
+        UV bits;
+        memcpy(&bits, entropy + PERL_HASH_SEED_BYTES, sizeof(bits));
+        PL_hash_rand_bits ^= bits;
+      }
+    }
+  }
+  PERL_HASH_SEED_STATE(PERL_HASH_SEED, PL_hash_state);
+#ifdef PERL_USE_SINGLE_CHAR_HASH_CACHE
+  {
+    char str[2] = "\0";
+    for (int i = 0; i < 256; i++) {
+      str[0] = (char)i;
+      PERL_HASH_WITH_STATE(PL_hash_state, PL_hash_chars[i], str, 1);
+    }
+    PERL_HASH_WITH_STATE(PL_hash_state, PL_hash_chars[256], str, 0);
+  }
+#endif
+
+  // Every key's hash must be current before any hash is rebucketed
+  for (int pass = 0; pass < 2; pass++) {
+    for (SV *sva = PL_sv_arenaroot; sva; sva = MUTABLE_SV(SvANY(sva))) {
+      const SV *svend = &sva[SvREFCNT(sva)];
+      for (SV *sv = sva + 1; sv < svend; sv++) {
+        if (SvTYPE(sv) != SVt_PVHV || !SvREFCNT(sv) || !HvARRAY(sv)) {
+          continue;
+        }
+        HV *hv = (HV *)sv;
+        if (pass == 1) {
+          zeroperl_rebucket(aTHX_ hv);
+          continue;
+        }
+        if (HvSHAREKEYS(hv)) {
+          continue;
+        }
+        for (STRLEN i = 0; i <= HvMAX(hv); i++) {
+          for (HE *he = HvARRAY(hv)[i]; he; he = HeNEXT(he)) {
+            HEK *hek = HeKEY_hek(he);
+            PERL_HASH(HEK_HASH(hek), HEK_KEY(hek), HEK_LEN(hek));
+          }
+        }
+      }
+    }
+  }
+}
+#endif
+
+//! Gives a build-time pre-initialized image this instance's state: %ENV,
+//! $^T, the hash seed and the srand() state; runs once, on the first
+//! zeroperl_init() or zeroperl_init_with_args()
+static void zeroperl_refresh_instance(void) {
+  dTHX;
+  HV *env = GvHVn(PL_envgv);
+
+  // Clear without %ENV's magic: it would clear the C environment, which
+  // is about to be loaded fresh from the host
+  SvRMAGICAL_off(env);
+  hv_clear(env);
+  SvRMAGICAL_on(env);
+
+  __wasilibc_initialize_environ();
+  for (char **e = environ; e && *e; e++) {
+    const char *eq = strchr(*e, '=');
+    if (eq) {
+      (void)hv_store(env, *e, (I32)(eq - *e), newSVpv(eq + 1, 0), 0);
+    }
+  }
+
+  PL_basetime = time(NULL);
+  PL_srand_called = FALSE;
+#ifdef USE_HASH_SEED
+  zeroperl_reseed_hashes(aTHX);
+#endif
+  zero_perl_preinitialized = false;
+}
+
 //! Initialize the Perl interpreter
 //!
 //! Performs complete Perl system initialization and creates an interpreter
@@ -954,6 +2987,9 @@ static int zeroperl_reset_callback(int argc, char **argv) {
 ZEROPERL_API("zeroperl_init")
 int zeroperl_init(void) {
   if (zero_perl) {
+    if (zero_perl_preinitialized) {
+      zeroperl_refresh_instance();
+    }
     return 0;
   }
 
@@ -968,10 +3004,26 @@ int zeroperl_init(void) {
 //! Alternative to zeroperl_init() for when you want to run a complete Perl
 //! program from a file or with command-line arguments.
 //!
+//! A pre-initialized image has already parsed its own command line, so
+//! arguments beyond argv[0] cannot be honoured there: the call refreshes
+//! the instance as zeroperl_init() does and then fails, leaving the
+//! interpreter usable through zeroperl_eval() and zeroperl_run_file().
+//!
 //! Returns 0 on success, non-zero on error.
 ZEROPERL_API("zeroperl_init_with_args")
 int zeroperl_init_with_args(int argc, char **argv) {
   if (zero_perl) {
+    bool preinitialized = zero_perl_preinitialized;
+    if (preinitialized) {
+      zeroperl_refresh_instance();
+    }
+    if (preinitialized && argc > 1 && argv) {
+      snprintf(zero_perl_error_buf, sizeof(zero_perl_error_buf),
+               "pre-initialized interpreter cannot take command-line "
+               "arguments; pass them to zeroperl_eval() or "
+               "zeroperl_run_file()");
+      return -1;
+    }
     return 0;
   }
 
@@ -1008,7 +3060,7 @@ int zeroperl_eval(const char *code, zeroperl_context_type context, int argc,
       .result = 0,
       .data.eval = {
           .code = code, .argc = argc, .argv = argv, .context = context}};
-  return asyncjmp_rt_start(zeroperl_eval_callback, 0, (char **)&ctx);
+  return zeroperl_run(zeroperl_eval_callback, &ctx);
 }
 
 //! Run a Perl program file
@@ -1031,7 +3083,7 @@ int zeroperl_run_file(const char *filepath, int argc, char **argv) {
       .op_type = ZEROPERL_OP_RUN_FILE,
       .result = 0,
       .data.run_file = {.filepath = filepath, .argc = argc, .argv = argv}};
-  return asyncjmp_rt_start(zeroperl_run_file_callback, 0, (char **)&ctx);
+  return zeroperl_run(zeroperl_run_file_callback, &ctx);
 }
 
 //! Free the Perl interpreter
@@ -1041,7 +3093,9 @@ int zeroperl_run_file(const char *filepath, int argc, char **argv) {
 ZEROPERL_API("zeroperl_free_interpreter")
 void zeroperl_free_interpreter(void) {
   if (zero_perl) {
+    zeroperl_scopes_end_all();
     perl_destruct(zero_perl);
+    zeroperl_shared_release_all();
     perl_free(zero_perl);
     zero_perl = NULL;
     zero_perl_can_evaluate = false;
@@ -1113,30 +3167,271 @@ bool zeroperl_can_evaluate(void) { return zero_perl_can_evaluate; }
 //!
 //! Forces any buffered output to be written immediately.
 //!
-//! Returns 0 on success, -1 if interpreter not initialized.
-ZEROPERL_API("zeroperl_flush")
-int zeroperl_flush(void) {
-  if (!zero_perl || !zero_perl_can_evaluate) {
+//! Returns 0 on success, -1 if interpreter not initialized.
+ZEROPERL_API("zeroperl_flush")
+int zeroperl_flush(void) {
+  if (!zero_perl || !zero_perl_can_evaluate) {
+    return -1;
+  }
+
+  dTHX;
+
+  PerlIO *pout = PerlIO_stdout();
+  if (pout) {
+    if (PerlIO_flush(pout) != 0) {
+      return -1;
+    }
+  }
+
+  PerlIO *perr = PerlIO_stderr();
+  if (perr) {
+    if (PerlIO_flush(perr) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+#if defined(__wasm__)
+//! Linker-provided layout symbols. The module links with --stack-first, so
+//! linear memory is [shadow stack][globals][heap] and everything from
+//! __stack_high to the end of memory is program state
+extern unsigned char __stack_high[];
+#endif
+
+//! Linear-memory image captured by zeroperl_snapshot()
+//! These variables are set before the image is taken, so a restore brings
+//! them back with the same values
+static unsigned char *zero_snapshot = NULL;
+static size_t zero_snapshot_size = 0;
+static uintptr_t zero_snapshot_memory_end = 0;
+
+#if defined(__wasm__)
+static uintptr_t zeroperl_memory_end(void) {
+  return (uintptr_t)__builtin_wasm_memory_size(0) * 65536;
+}
+
+//! Splits program state into the spans either side of the image's own
+//! buffer; the shadow stack (live frames of this call) is never included
+//! Returns the total number of bytes the spans cover
+static size_t zeroperl_snapshot_spans(uintptr_t spans[2][2]) {
+  uintptr_t lo = (uintptr_t)__stack_high;
+  uintptr_t hole_lo = zero_snapshot ? (uintptr_t)zero_snapshot : lo;
+  uintptr_t hole_hi = hole_lo + zero_snapshot_size;
+  spans[0][0] = lo;
+  spans[0][1] = hole_lo;
+  spans[1][0] = hole_hi;
+  spans[1][1] = zero_snapshot_memory_end;
+  return (spans[0][1] - spans[0][0]) + (spans[1][1] - spans[1][0]);
+}
+
+//! Copies program state into (save) or back out of the snapshot image
+static void zeroperl_snapshot_copy(bool save) {
+  uintptr_t spans[2][2];
+  zeroperl_snapshot_spans(spans);
+  unsigned char *img = zero_snapshot;
+  for (int i = 0; i < 2; i++) {
+    size_t len = spans[i][1] - spans[i][0];
+    if (save) {
+      memcpy(img, (const void *)spans[i][0], len);
+    } else {
+      memcpy((void *)spans[i][0], img, len);
+    }
+    img += len;
+  }
+}
+#endif
+
+//! Capture the current interpreter state for zeroperl_restore()
+//!
+//! Takes a copy of the module's globals and heap, typically right after
+//! zeroperl_init() and preloading modules. Replaces any earlier snapshot.
+//! Must be called from the host, never from inside a Perl call.
+//!
+//! Returns 0 on success, -1 on error.
+ZEROPERL_API("zeroperl_snapshot")
+int zeroperl_snapshot(void) {
+#if defined(__wasm__)
+  zeroperl_flush();
+  fflush(NULL);
+
+  free(zero_snapshot);
+  zero_snapshot = NULL;
+  zero_snapshot_size = 0;
+  zero_snapshot_memory_end = zeroperl_memory_end();
+
+  // The buffer lives in the heap it copies, so size it, allocate it, then
+  // check it still covers the heap minus itself (allocating may grow memory)
+  uintptr_t spans[2][2];
+  size_t need = zeroperl_snapshot_spans(spans);
+  for (;;) {
+    zero_snapshot = malloc(need);
+    if (!zero_snapshot) {
+      zero_snapshot_size = 0;
+      return -1;
+    }
+    zero_snapshot_size = need;
+    zero_snapshot_memory_end = zeroperl_memory_end();
+
+    size_t have = zeroperl_snapshot_spans(spans);
+    if (have <= need) {
+      break;
+    }
+    free(zero_snapshot);
+    zero_snapshot = NULL;
+    need = have + 65536;
+  }
+
+  zeroperl_snapshot_copy(true);
+  return 0;
+#else
+  errno = ENOSYS;
+  return -1;
+#endif
+}
+
+//! Roll the module back to the last zeroperl_snapshot()
+//!
+//! A bulk copy over the globals and heap: the interpreter, loaded modules,
+//! SFS mounts and the allocator's bookkeeping return to their captured
+//! state, which also releases anything the host allocated since. Host-side
+//! resources opened since (WASI descriptors, host buffers) are not tracked
+//! and must be re-established by the host. Must be called from the host,
+//! never from inside a Perl call.
+//!
+//! Linear memory cannot shrink, and the restored allocator knows nothing of
+//! pages added after the snapshot, so those would be stranded for good. If
+//! memory has grown since the snapshot the restore is refused; the host
+//! should re-instantiate the module instead.
+//!
+//! Returns 0 on success, -1 if there is no snapshot or memory has grown
+//! (errno ENOMEM, message in zeroperl_last_error()).
+ZEROPERL_API("zeroperl_restore")
+int zeroperl_restore(void) {
+#if defined(__wasm__)
+  if (!zero_snapshot) {
+    return -1;
+  }
+  zeroperl_flush();
+  fflush(NULL);
+  if (zeroperl_memory_end() != zero_snapshot_memory_end) {
+    snprintf(zero_perl_error_buf, sizeof(zero_perl_error_buf),
+             "memory grew from %lu to %lu bytes since the snapshot",
+             (unsigned long)zero_snapshot_memory_end,
+             (unsigned long)zeroperl_memory_end());
+    errno = ENOMEM;
+    return -1;
+  }
+  zeroperl_snapshot_copy(false);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+//! Pre-initialize the interpreter at build time (pipeline/preinit.sh)
+//!
+//! Runs zeroperl_init() and `use`s each module named in the whitespace
+//! separated ZEROPERL_PRELOAD environment variable, then drops the build
+//! host's environment and preopens so the snapshot does not carry them.
+//! tools/preinit.js snapshots memory after this returns; a failure traps so
+//! the build stops instead of shipping a half-initialized image.
+ZEROPERL_API("zeroperl_preinit")
+void zeroperl_preinit(void) {
+  if (zero_perl) {
+    return;
+  }
+  if (zeroperl_init() != 0) {
+    __builtin_trap();
+  }
+
+  const char *preload = getenv("ZEROPERL_PRELOAD");
+  if (preload && *preload) {
+    dTHX;
+    SV *code = newSVpvs("");
+    const char *p = preload;
+    while (*p) {
+      size_t skip = strspn(p, " \t\n,");
+      p += skip;
+      size_t len = strcspn(p, " \t\n,");
+      if (len > 0) {
+        sv_catpvf(code, "use %.*s;\n", (int)len, p);
+      }
+      p += len;
+    }
+    int rc = zeroperl_eval(SvPV_nolen(code), ZEROPERL_VOID, 0, NULL);
+    SvREFCNT_dec(code);
+    if (rc != 0) {
+      fprintf(stderr, "zeroperl_preinit: %s\n", zeroperl_last_error());
+      __builtin_trap();
+    }
+  }
+
+  zeroperl_flush();
+  fflush(NULL);
+  __wasilibc_deinitialize_environ();
+  __wasilibc_reset_preopens();
+  zero_perl_preinitialized = true;
+}
+
+//! Open a handle scope
+//!
+//! Until the matching zeroperl_scope_end(), every value, array and hash
+//! handle the API hands out (zeroperl_new_*, zeroperl_array_get,
+//! zeroperl_hash_get, zeroperl_hash_iter_next, ...) comes from a bump arena
+//! instead of malloc. Values in a zeroperl_result are owned by the result
+//! and stay valid until zeroperl_result_free(), whenever that runs. Scopes
+//! nest up to MAX_HANDLE_SCOPES deep.
+//!
+//! Returns 0 on success, -1 if too many scopes are open.
+ZEROPERL_API("zeroperl_scope_begin")
+int zeroperl_scope_begin(void) {
+  if (handle_scope_depth >= MAX_HANDLE_SCOPES) {
+    return -1;
+  }
+
+  handle_scope_marks[handle_scope_depth++] = handle_top;
+  return 0;
+}
+
+//! Close the innermost handle scope
+//!
+//! Drops the reference of every handle allocated since the matching
+//! zeroperl_scope_begin() and invalidates them all at once. Freeing such a
+//! handle earlier is allowed but not needed. Values that must outlive the
+//! scope go through zeroperl_scope_escape().
+//!
+//! Returns 0 on success, -1 if no scope is open.
+ZEROPERL_API("zeroperl_scope_end")
+int zeroperl_scope_end(void) {
+  if (handle_scope_depth == 0) {
     return -1;
   }
 
-  dTHX;
+  zeroperl_handles_release(handle_scope_marks[--handle_scope_depth]);
+  return 0;
+}
 
-  PerlIO *pout = PerlIO_stdout();
-  if (pout) {
-    if (PerlIO_flush(pout) != 0) {
-      return -1;
-    }
+//! Move a value handle out of its scope
+//!
+//! Returns a malloc'd handle to the same value, which the caller must free
+//! with zeroperl_value_free(); val itself becomes invalid. A handle that is
+//! not scoped is returned as is.
+ZEROPERL_API("zeroperl_scope_escape")
+zeroperl_value *zeroperl_scope_escape(zeroperl_value *val) {
+  if (!val || !zeroperl_handle_scoped(val)) {
+    return val;
   }
 
-  PerlIO *perr = PerlIO_stderr();
-  if (perr) {
-    if (PerlIO_flush(perr) != 0) {
-      return -1;
-    }
+  zeroperl_value *out = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  if (!out) {
+    return NULL;
   }
 
-  return 0;
+  out->sv = val->sv;
+  val->sv = NULL;
+  return out;
 }
 
 //! Create a new integer value
@@ -1147,7 +3442,7 @@ zeroperl_value *zeroperl_new_int(int32_t i) {
   }
 
   dTHX;
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     return NULL;
   }
@@ -1164,7 +3459,7 @@ zeroperl_value *zeroperl_new_uint(uint32_t u) {
   }
 
   dTHX;
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     return NULL;
   }
@@ -1181,7 +3476,7 @@ zeroperl_value *zeroperl_new_double(double d) {
   }
 
   dTHX;
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     return NULL;
   }
@@ -1191,32 +3486,126 @@ zeroperl_value *zeroperl_new_double(double d) {
 }
 
 //! Create a new string value (UTF-8)
-
+//!
+//! Returns NULL if str is not valid UTF-8. Pure ASCII strings are stored
+//! without Perl's UTF-8 flag, which they do not need.
 ZEROPERL_API("zeroperl_new_string")
 zeroperl_value *zeroperl_new_string(const char *str, size_t len) {
-  if (!zero_perl || !zero_perl_can_evaluate) {
+  if (!zero_perl || !zero_perl_can_evaluate || (!str && len > 0)) {
     return NULL;
   }
 
   dTHX;
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     return NULL;
   }
 
-  if (len == 0) {
-    val->sv = newSVpvn("", 0);
-    SvUTF8_on(val->sv);
-    return val;
+  val->sv = zeroperl_new_utf8_sv(aTHX_ len ? str : "", len);
+  if (!val->sv) {
+    zeroperl_handle_free(val);
+    return NULL;
   }
+  return val;
+}
 
-  if (!str) {
-    free(val);
+//! Create a new string value from UTF-16 code units
+//!
+//! Unpaired surrogates become U+FFFD, as with TextEncoder.
+ZEROPERL_API("zeroperl_new_string_utf16")
+zeroperl_value *zeroperl_new_string_utf16(const uint16_t *str, size_t len) {
+  if (!zero_perl || !zero_perl_can_evaluate || (!str && len > 0) ||
+      len > (SIZE_MAX - 2) / 3) {
+    return NULL;
+  }
+
+  dTHX;
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
+  if (!val) {
+    return NULL;
+  }
+
+  SV *sv = newSV(len * 3 + 1);
+  bool ascii;
+  STRLEN out_len = zeroperl_utf16_to_utf8(str, len, (U8 *)SvPVX(sv), &ascii);
+  SvCUR_set(sv, out_len);
+  *SvEND(sv) = '\0';
+  SvPOK_only(sv);
+  if (!ascii) {
+    SvUTF8_on(sv);
+  }
+  // The buffer was sized for three bytes per unit
+  SvPV_shrink_to_cur(sv);
+
+  val->sv = sv;
+  return val;
+}
+
+//! Wrap host memory as a read-only string value without copying
+//!
+//! ptr[0..len) becomes the scalar's buffer, as UTF-8 characters with
+//! ZEROPERL_SHARED_UTF8 (validated, and only flagged if not pure ASCII) and
+//! as bytes otherwise; ptr[len] must be a NUL byte,
+//! which Perl expects after every string. The region must stay valid and
+//! unchanged until it is released: when the scalar is freed, or at the
+//! latest on zeroperl_reset()/zeroperl_free_interpreter(), release (if not
+//! NULL) is called with ctx, ptr and len, and with ZEROPERL_SHARED_FREE the
+//! region, which must then come from malloc, is passed to free().
+//!
+//! Perl code can read the scalar in place (match, unpack, substr, pass it to
+//! subs); assigning it elsewhere copies. Returns NULL on invalid arguments.
+ZEROPERL_API("zeroperl_new_string_shared")
+zeroperl_value *zeroperl_new_string_shared(const char *ptr, size_t len,
+                                           int flags,
+                                           zeroperl_release_fn release,
+                                           void *ctx) {
+  if (!zero_perl || !zero_perl_can_evaluate || !ptr || ptr[len] != '\0') {
+    return NULL;
+  }
+
+  bool ascii = true;
+  if ((flags & ZEROPERL_SHARED_UTF8) &&
+      !zeroperl_utf8_validate((const U8 *)ptr, len, &ascii)) {
+    return NULL;
+  }
+
+  dTHX;
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
+  if (!val) {
+    return NULL;
+  }
+
+  zeroperl_shared *shared = (zeroperl_shared *)malloc(sizeof(zeroperl_shared));
+  if (!shared) {
+    zeroperl_handle_free(val);
     return NULL;
   }
 
-  val->sv = newSVpvn(str, len);
-  SvUTF8_on(val->sv);
+  shared->ptr = ptr;
+  shared->len = len;
+  shared->flags = flags;
+  shared->release = release;
+  shared->ctx = ctx;
+  shared->prev = NULL;
+  shared->next = shared_live;
+  if (shared_live) {
+    shared_live->prev = shared;
+  }
+  shared_live = shared;
+
+  SV *sv = newSV_type(SVt_PV);
+  SvPV_set(sv, (char *)ptr);
+  SvCUR_set(sv, len);
+  SvLEN_set(sv, 0);
+  SvPOK_only(sv);
+  if (!ascii) {
+    SvUTF8_on(sv);
+  }
+  sv_magicext(sv, NULL, PERL_MAGIC_ext, &zeroperl_shared_vtbl,
+              (const char *)shared, 0);
+  SvREADONLY_on(sv);
+
+  val->sv = sv;
   return val;
 }
 
@@ -1228,7 +3617,7 @@ zeroperl_value *zeroperl_new_bool(bool b) {
   }
 
   dTHX;
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     return NULL;
   }
@@ -1246,7 +3635,7 @@ zeroperl_value *zeroperl_new_undef(void) {
   }
 
   dTHX;
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     return NULL;
   }
@@ -1287,6 +3676,7 @@ bool zeroperl_to_double(zeroperl_value *val, double *out) {
 //!
 //! The returned string is owned by the value and should not be freed.
 //! If len is not NULL, it will be set to the string length in bytes.
+//! A byte string holding non-ASCII Latin-1 is upgraded to UTF-8 in place.
 ZEROPERL_API("zeroperl_to_string")
 const char *zeroperl_to_string(zeroperl_value *val, size_t *len) {
   if (!val || !val->sv) {
@@ -1294,8 +3684,28 @@ const char *zeroperl_to_string(zeroperl_value *val, size_t *len) {
   }
 
   dTHX;
-  STRLEN perl_len;
-  const char *str = SvPVutf8(val->sv, perl_len);
+  SV *sv = val->sv;
+  STRLEN perl_len = 0;
+  const char *str = NULL;
+
+  // ASCII is UTF-8 already and needs no flag, and Latin-1 goes through the
+  // block converter. Read-only and magic values take Perl's own upgrade, as
+  // do dualvars, whose numeric flags the buffer swap would drop
+  if (SvPOK(sv) && !SvUTF8(sv) && !SvGMAGICAL(sv)) {
+    STRLEN extra =
+        zeroperl_latin1_utf8_extra((const U8 *)SvPVX_const(sv), SvCUR(sv));
+    if (extra && !SvREADONLY(sv) && !SvNIOKp(sv)) {
+      zeroperl_sv_upgrade_latin1(aTHX_ sv);
+      extra = 0;
+    }
+    if (!extra) {
+      str = SvPVX_const(sv);
+      perl_len = SvCUR(sv);
+    }
+  }
+  if (!str) {
+    str = SvPVutf8(sv, perl_len);
+  }
 
   if (len) {
     *len = perl_len;
@@ -1304,6 +3714,109 @@ const char *zeroperl_to_string(zeroperl_value *val, size_t *len) {
   return str;
 }
 
+//! Convert a value to UTF-16 code units
+//!
+//! Returns the number of units the string needs; they are written to out
+//! only if that fits in out_len, so a host can size its buffer with a first
+//! call. The value is not modified. Returns 0 on invalid arguments.
+ZEROPERL_API("zeroperl_to_string_utf16")
+size_t zeroperl_to_string_utf16(zeroperl_value *val, uint16_t *out,
+                                size_t out_len) {
+  if (!zero_perl || !val || !val->sv) {
+    return 0;
+  }
+
+  dTHX;
+  STRLEN len;
+  const U8 *s = (const U8 *)SvPV_const(val->sv, len);
+  bool utf8 = SvUTF8(val->sv) != 0;
+
+  // Every byte yields at most one unit, so a buffer that large needs no
+  // counting pass
+  if (out && out_len >= len) {
+    return zeroperl_perl_to_utf16(s, len, utf8, out);
+  }
+
+  size_t units = zeroperl_perl_to_utf16(s, len, utf8, NULL);
+  if (out && units <= out_len) {
+    zeroperl_perl_to_utf16(s, len, utf8, out);
+  }
+  return units;
+}
+
+//! View of a scalar's string buffer (zeroperl_view_open)
+typedef struct zeroperl_view_s {
+  SV *sv; // holds the viewed buffer
+} zeroperl_view;
+
+//! Expose a value's string buffer without copying or upgrading
+//!
+//! Sets *ptr and *len to the scalar's own buffer and *utf8 to whether it
+//! holds UTF-8 characters (otherwise bytes/Latin-1, as Perl stores it). The
+//! view takes a copy-on-write copy of the value, which shares its buffer and
+//! keeps it alive until zeroperl_view_close(): Perl code may go on to write
+//! to or upgrade the value (utf8::upgrade reallocates), and the view still
+//! sees the string as it was when opened. Small or mostly empty buffers
+//! Perl will not share, and read-only values or ones with a numeric form
+//! (unless already shared), are copied once. All views must be closed
+//! before zeroperl_reset().
+//!
+//! Returns NULL if the value has no buffer of its own (references,
+//! aggregates), in which case zeroperl_to_string() is the fallback.
+ZEROPERL_API("zeroperl_view_open")
+zeroperl_view *zeroperl_view_open(zeroperl_value *val, const char **ptr,
+                                  size_t *len, bool *utf8) {
+  if (!zero_perl || !val || !val->sv || !ptr) {
+    return NULL;
+  }
+
+  dTHX;
+  SV *sv = val->sv;
+  if (SvROK(sv) || SvTYPE(sv) >= SVt_PVAV) {
+    return NULL;
+  }
+
+  STRLEN perl_len;
+  const char *str = SvPV(sv, perl_len);
+  if (!SvPOKp(sv) || str != SvPVX_const(sv)) {
+    return NULL;
+  }
+
+  zeroperl_view *view = (zeroperl_view *)malloc(sizeof(zeroperl_view));
+  if (!view) {
+    return NULL;
+  }
+
+  // Outside the core SV_DO_COW_SVSETSV is 0, so ask for the COW explicitly
+  view->sv = newSV(0);
+  sv_setsv_flags(view->sv, sv,
+                 SV_NOSTEAL | SV_COW_SHARED_HASH_KEYS | SV_COW_OTHER_PVS);
+  str = SvPVX_const(view->sv);
+
+  *ptr = str;
+  if (len) {
+    *len = perl_len;
+  }
+  if (utf8) {
+    *utf8 = SvUTF8(sv) != 0;
+  }
+  return view;
+}
+
+//! Close a view, releasing its hold on the buffer
+ZEROPERL_API("zeroperl_view_close")
+void zeroperl_view_close(zeroperl_view *view) {
+  if (!view) {
+    return;
+  }
+
+  if (zero_perl) {
+    dTHX;
+    SvREFCNT_dec(view->sv);
+  }
+  free(view);
+}
+
 //! Convert a value to a boolean
 ZEROPERL_API("zeroperl_to_bool")
 bool zeroperl_to_bool(zeroperl_value *val) {
@@ -1413,7 +3926,7 @@ void zeroperl_value_free(zeroperl_value *val) {
     SvREFCNT_dec(val->sv);
   }
 
-  free(val);
+  zeroperl_handle_free(val);
 }
 
 //! Create a new empty array
@@ -1424,7 +3937,7 @@ zeroperl_array *zeroperl_new_array(void) {
   }
 
   dTHX;
-  zeroperl_array *arr = (zeroperl_array *)malloc(sizeof(zeroperl_array));
+  zeroperl_array *arr = (zeroperl_array *)zeroperl_handle_alloc();
   if (!arr) {
     return NULL;
   }
@@ -1460,7 +3973,7 @@ zeroperl_value *zeroperl_array_pop(zeroperl_array *arr) {
     return NULL;
   }
 
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     SvREFCNT_dec(sv);
     return NULL;
@@ -1492,7 +4005,7 @@ zeroperl_value *zeroperl_array_get(zeroperl_array *arr, size_t index) {
     return NULL;
   }
 
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     return NULL;
   }
@@ -1539,6 +4052,223 @@ void zeroperl_array_clear(zeroperl_array *arr) {
   av_clear(arr->av);
 }
 
+//! Element i of av for the bulk exports, NULL for a hole
+static SV *zeroperl_array_elem(pTHX_ AV *av, SSize_t i) {
+  if (!SvRMAGICAL(av)) {
+    return AvARRAY(av)[i];
+  }
+  SV **svp = av_fetch(av, i, 0);
+  return svp ? *svp : NULL;
+}
+
+//! Shared body of the numeric bulk exports; kind is 'd', 'i' or 'l'
+static size_t zeroperl_array_export_num(zeroperl_array *arr, void *out,
+                                        size_t n, char kind) {
+  if (!arr || !arr->av || (!out && n > 0)) {
+    return 0;
+  }
+
+  dTHX;
+  SSize_t count = av_top_index(arr->av) + 1;
+  if ((size_t)count > n) {
+    count = (SSize_t)n;
+  }
+
+  for (SSize_t i = 0; i < count; i++) {
+    SV *sv = zeroperl_array_elem(aTHX_ arr->av, i);
+    switch (kind) {
+    case 'd':
+      ((double *)out)[i] = sv ? (double)SvNV(sv) : 0.0;
+      break;
+    case 'i':
+      ((int32_t *)out)[i] = sv ? (int32_t)SvIV(sv) : 0;
+      break;
+    default:
+      ((int64_t *)out)[i] = sv ? (int64_t)SvIV(sv) : 0;
+      break;
+    }
+  }
+  return (size_t)count;
+}
+
+//! Copy an array of numbers into a flat buffer of doubles
+//!
+//! Writes min(n, length) elements, numified as Perl would (holes and undef
+//! become 0), and returns how many were written. out can then be viewed as
+//! a Float64Array without any per-element calls.
+ZEROPERL_API("zeroperl_array_export_f64")
+size_t zeroperl_array_export_f64(zeroperl_array *arr, double *out, size_t n) {
+  return zeroperl_array_export_num(arr, out, n, 'd');
+}
+
+//! Copy an array of numbers into a flat buffer of int32s
+//!
+//! As zeroperl_array_export_f64; values outside int32 range are truncated.
+ZEROPERL_API("zeroperl_array_export_i32")
+size_t zeroperl_array_export_i32(zeroperl_array *arr, int32_t *out,
+                                 size_t n) {
+  return zeroperl_array_export_num(arr, out, n, 'i');
+}
+
+//! Copy an array of numbers into a flat buffer of int64s
+ZEROPERL_API("zeroperl_array_export_i64")
+size_t zeroperl_array_export_i64(zeroperl_array *arr, int64_t *out,
+                                 size_t n) {
+  return zeroperl_array_export_num(arr, out, n, 'l');
+}
+
+//! Copy an array of strings into one packed UTF-8 buffer
+//!
+//! offsets receives n + 1 entries: string i is buf[offsets[i]] up to
+//! buf[offsets[i + 1]], without terminators. Only the first n elements are
+//! exported, stringified as Perl would. Returns the number of bytes the
+//! strings need. If that exceeds buf_len, buf only receives the leading
+//! strings that fit whole (offsets are still filled for all of them), so a
+//! host sizes the buffer with a first call, with buf NULL to skip copying,
+//! and retries. Returns 0 with offsets untouched on invalid arguments.
+ZEROPERL_API("zeroperl_array_export_strings")
+size_t zeroperl_array_export_strings(zeroperl_array *arr, char *buf,
+                                     size_t buf_len, uint32_t *offsets,
+                                     size_t n) {
+  if (!arr || !arr->av || !offsets) {
+    return 0;
+  }
+
+  dTHX;
+  SSize_t count = av_top_index(arr->av) + 1;
+  if ((size_t)count > n) {
+    count = (SSize_t)n;
+  }
+
+  ENTER;
+  SAVETMPS;
+
+  size_t total = 0;
+  offsets[0] = 0;
+  for (SSize_t i = 0; i < count; i++) {
+    SV *sv = zeroperl_array_elem(aTHX_ arr->av, i);
+    STRLEN len = 0;
+    const char *p = sv ? zeroperl_sv_utf8(aTHX_ sv, &len) : "";
+    if (buf && total + len <= buf_len) {
+      memcpy(buf + total, p, len);
+    }
+    total += len;
+    offsets[i + 1] = (uint32_t)total;
+  }
+  for (size_t i = (size_t)count; i < n; i++) {
+    offsets[i + 1] = (uint32_t)total;
+  }
+
+  FREETMPS;
+  LEAVE;
+  return total;
+}
+
+//! Shared body of the numeric bulk imports; kind is 'd', 'i' or 'l'
+static zeroperl_array *zeroperl_array_import_num(const void *data, size_t n,
+                                                 char kind) {
+  if (!zero_perl || !zero_perl_can_evaluate || (!data && n > 0)) {
+    return NULL;
+  }
+
+  dTHX;
+  zeroperl_array *arr = (zeroperl_array *)zeroperl_handle_alloc();
+  if (!arr) {
+    return NULL;
+  }
+
+  AV *av = newAV();
+  if (n > 0) {
+    av_extend(av, (SSize_t)n - 1);
+    SV **svs = AvARRAY(av);
+    for (size_t i = 0; i < n; i++) {
+      switch (kind) {
+      case 'd':
+        svs[i] = newSVnv(((const double *)data)[i]);
+        break;
+      case 'i':
+        svs[i] = newSViv(((const int32_t *)data)[i]);
+        break;
+      default:
+        svs[i] = newSViv((IV)((const int64_t *)data)[i]);
+        break;
+      }
+    }
+    AvFILLp(av) = (SSize_t)n - 1;
+  }
+
+  arr->av = av;
+  return arr;
+}
+
+//! Create an array from a flat buffer of n doubles
+//!
+//! The caller must free the returned array.
+ZEROPERL_API("zeroperl_array_import_f64")
+zeroperl_array *zeroperl_array_import_f64(const double *data, size_t n) {
+  return zeroperl_array_import_num(data, n, 'd');
+}
+
+//! Create an array from a flat buffer of n int32s
+ZEROPERL_API("zeroperl_array_import_i32")
+zeroperl_array *zeroperl_array_import_i32(const int32_t *data, size_t n) {
+  return zeroperl_array_import_num(data, n, 'i');
+}
+
+//! Create an array from a flat buffer of n int64s
+ZEROPERL_API("zeroperl_array_import_i64")
+zeroperl_array *zeroperl_array_import_i64(const int64_t *data, size_t n) {
+  return zeroperl_array_import_num(data, n, 'l');
+}
+
+//! Create an array of n UTF-8 strings from a packed buffer
+//!
+//! Same layout as zeroperl_array_export_strings: offsets has n + 1 entries.
+//! Returns NULL if the offsets are not ascending or a string is not valid
+//! UTF-8. The caller must free the
+//! returned array.
+ZEROPERL_API("zeroperl_array_import_strings")
+zeroperl_array *zeroperl_array_import_strings(const char *buf,
+                                              const uint32_t *offsets,
+                                              size_t n) {
+  if (!zero_perl || !zero_perl_can_evaluate || !offsets ||
+      (!buf && offsets[n] > offsets[0])) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    if (offsets[i + 1] < offsets[i]) {
+      return NULL;
+    }
+  }
+
+  dTHX;
+  zeroperl_array *arr = (zeroperl_array *)zeroperl_handle_alloc();
+  if (!arr) {
+    return NULL;
+  }
+
+  AV *av = newAV();
+  if (n > 0) {
+    av_extend(av, (SSize_t)n - 1);
+    SV **svs = AvARRAY(av);
+    for (size_t i = 0; i < n; i++) {
+      SV *sv = zeroperl_new_utf8_sv(aTHX_ buf + offsets[i],
+                                    offsets[i + 1] - offsets[i]);
+      if (!sv) {
+        SvREFCNT_dec((SV *)av);
+        zeroperl_handle_free(arr);
+        return NULL;
+      }
+      svs[i] = sv;
+      AvFILLp(av) = (SSize_t)i;
+    }
+  }
+
+  arr->av = av;
+  return arr;
+}
+
 //! Convert an array to a value
 //!
 //! Creates a reference to the array. The caller must free the returned value.
@@ -1549,7 +4279,7 @@ zeroperl_value *zeroperl_array_to_value(zeroperl_array *arr) {
   }
 
   dTHX;
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     return NULL;
   }
@@ -1579,7 +4309,7 @@ zeroperl_array *zeroperl_value_to_array(zeroperl_value *val) {
     return NULL;
   }
 
-  zeroperl_array *arr = (zeroperl_array *)malloc(sizeof(zeroperl_array));
+  zeroperl_array *arr = (zeroperl_array *)zeroperl_handle_alloc();
   if (!arr) {
     return NULL;
   }
@@ -1600,7 +4330,7 @@ void zeroperl_array_free(zeroperl_array *arr) {
     SvREFCNT_dec((SV *)arr->av);
   }
 
-  free(arr);
+  zeroperl_handle_free(arr);
 }
 
 //! Create a new empty hash
@@ -1611,7 +4341,7 @@ zeroperl_hash *zeroperl_new_hash(void) {
   }
 
   dTHX;
-  zeroperl_hash *hash = (zeroperl_hash *)malloc(sizeof(zeroperl_hash));
+  zeroperl_hash *hash = (zeroperl_hash *)zeroperl_handle_alloc();
   if (!hash) {
     return NULL;
   }
@@ -1652,7 +4382,7 @@ zeroperl_value *zeroperl_hash_get(zeroperl_hash *hash, const char *key) {
     return NULL;
   }
 
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     return NULL;
   }
@@ -1682,14 +4412,124 @@ bool zeroperl_hash_delete(zeroperl_hash *hash, const char *key) {
   }
 
   dTHX;
-  SV *sv = hv_delete(hash->hv, key, strlen(key), 0);
+  // The removed value comes back mortal, so it is released with the
+  // caller's temporaries
+  return hv_delete(hash->hv, key, strlen(key), 0) != NULL;
+}
 
-  if (sv) {
+//! Intern a hash key for repeated lookups
+//!
+//! The key is UTF-8 and is hashed once here; the _by_key accessors then skip
+//! strlen and hashing on every call. Returns NULL if the key is not valid
+//! UTF-8. The caller must free the key with zeroperl_key_free().
+ZEROPERL_API("zeroperl_key_intern")
+zeroperl_key *zeroperl_key_intern(const char *str, size_t len) {
+  if (!zero_perl || !zero_perl_can_evaluate || (!str && len > 0) ||
+      len > I32_MAX) {
+    return NULL;
+  }
+
+  bool ascii;
+  if (len && !zeroperl_utf8_validate((const U8 *)str, len, &ascii)) {
+    return NULL;
+  }
+
+  dTHX;
+  zeroperl_key *key = (zeroperl_key *)zeroperl_handle_alloc();
+  if (!key) {
+    return NULL;
+  }
+
+  // A negative length marks the key as UTF-8; Perl stores it downgraded
+  // when it fits in Latin-1, as it does for hash keys from Perl code
+  I32 klen = (I32)len;
+  key->sv = newSVpvn_share(len ? str : "", (len && !ascii) ? -klen : klen, 0);
+  return key;
+}
+
+//! Free an interned key
+ZEROPERL_API("zeroperl_key_free")
+void zeroperl_key_free(zeroperl_key *key) {
+  if (!key) {
+    return;
+  }
+
+  if (key->sv) {
+    dTHX;
+    SvREFCNT_dec(key->sv);
+  }
+
+  zeroperl_handle_free(key);
+}
+
+//! Set a value in a hash by interned key
+//!
+//! Returns true on success, false on failure.
+ZEROPERL_API("zeroperl_hash_set_by_key")
+bool zeroperl_hash_set_by_key(zeroperl_hash *hash, zeroperl_key *key,
+                              zeroperl_value *val) {
+  if (!hash || !hash->hv || !key || !key->sv || !val || !val->sv) {
+    return false;
+  }
+
+  dTHX;
+  SV *sv = SvREFCNT_inc(val->sv);
+  if (!hv_store_ent(hash->hv, key->sv, sv, 0)) {
     SvREFCNT_dec(sv);
-    return true;
+    return false;
   }
+  return true;
+}
 
-  return false;
+//! Get a value from a hash by interned key
+//!
+//! Returns NULL if the key doesn't exist. The caller must free the returned
+//! value.
+ZEROPERL_API("zeroperl_hash_get_by_key")
+zeroperl_value *zeroperl_hash_get_by_key(zeroperl_hash *hash,
+                                         zeroperl_key *key) {
+  if (!hash || !hash->hv || !key || !key->sv) {
+    return NULL;
+  }
+
+  dTHX;
+  HE *he = hv_fetch_ent(hash->hv, key->sv, 0, 0);
+
+  if (!he || !HeVAL(he)) {
+    return NULL;
+  }
+
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
+  if (!val) {
+    return NULL;
+  }
+
+  val->sv = SvREFCNT_inc(HeVAL(he));
+  return val;
+}
+
+//! Check if an interned key exists in a hash
+ZEROPERL_API("zeroperl_hash_exists_by_key")
+bool zeroperl_hash_exists_by_key(zeroperl_hash *hash, zeroperl_key *key) {
+  if (!hash || !hash->hv || !key || !key->sv) {
+    return false;
+  }
+
+  dTHX;
+  return hv_exists_ent(hash->hv, key->sv, 0);
+}
+
+//! Delete an interned key from a hash
+//!
+//! Returns true if the key was deleted, false if it didn't exist.
+ZEROPERL_API("zeroperl_hash_delete_by_key")
+bool zeroperl_hash_delete_by_key(zeroperl_hash *hash, zeroperl_key *key) {
+  if (!hash || !hash->hv || !key || !key->sv) {
+    return false;
+  }
+
+  dTHX;
+  return hv_delete_ent(hash->hv, key->sv, 0, 0) != NULL;
 }
 
 //! Clear all entries from a hash
@@ -1753,7 +4593,7 @@ bool zeroperl_hash_iter_next(zeroperl_hash_iter *iter, const char **key,
   if (val) {
     SV *sv = hv_iterval(iter->hv, iter->entry);
 
-    zeroperl_value *value = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+    zeroperl_value *value = (zeroperl_value *)zeroperl_handle_alloc();
     if (!value) {
       return false;
     }
@@ -1785,7 +4625,7 @@ zeroperl_value *zeroperl_hash_to_value(zeroperl_hash *hash) {
   }
 
   dTHX;
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     return NULL;
   }
@@ -1815,7 +4655,7 @@ zeroperl_hash *zeroperl_value_to_hash(zeroperl_value *val) {
     return NULL;
   }
 
-  zeroperl_hash *hash = (zeroperl_hash *)malloc(sizeof(zeroperl_hash));
+  zeroperl_hash *hash = (zeroperl_hash *)zeroperl_handle_alloc();
   if (!hash) {
     return NULL;
   }
@@ -1836,7 +4676,7 @@ void zeroperl_hash_free(zeroperl_hash *hash) {
     SvREFCNT_dec((SV *)hash->hv);
   }
 
-  free(hash);
+  zeroperl_handle_free(hash);
 }
 
 //! Create a new reference to a value
@@ -1849,7 +4689,7 @@ zeroperl_value *zeroperl_new_ref(zeroperl_value *val) {
   }
 
   dTHX;
-  zeroperl_value *ref = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *ref = (zeroperl_value *)zeroperl_handle_alloc();
   if (!ref) {
     return NULL;
   }
@@ -1874,7 +4714,7 @@ zeroperl_value *zeroperl_deref(zeroperl_value *ref) {
     return NULL;
   }
 
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
     return NULL;
   }
@@ -1894,102 +4734,697 @@ bool zeroperl_is_ref(zeroperl_value *val) {
   return SvROK(val->sv);
 }
 
-//! Get a global scalar variable
+//! Get a global scalar variable
+//!
+//! Returns NULL if the variable doesn't exist. The caller must free the
+//! returned value.
+ZEROPERL_API("zeroperl_get_var")
+zeroperl_value *zeroperl_get_var(const char *name) {
+  if (!zero_perl || !zero_perl_can_evaluate || !name) {
+    return NULL;
+  }
+
+  dTHX;
+  SV *sv = get_sv(name, 0);
+
+  if (!sv) {
+    return NULL;
+  }
+
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
+  if (!val) {
+    return NULL;
+  }
+
+  val->sv = SvREFCNT_inc(sv);
+  return val;
+}
+
+//! Get a global array variable
+//!
+//! Returns NULL if the variable doesn't exist. The caller must free the
+//! returned array.
+ZEROPERL_API("zeroperl_get_array_var")
+zeroperl_array *zeroperl_get_array_var(const char *name) {
+  if (!zero_perl || !zero_perl_can_evaluate || !name) {
+    return NULL;
+  }
+
+  dTHX;
+  AV *av = get_av(name, 0);
+
+  if (!av) {
+    return NULL;
+  }
+
+  zeroperl_array *arr = (zeroperl_array *)zeroperl_handle_alloc();
+  if (!arr) {
+    return NULL;
+  }
+
+  arr->av = (AV *)SvREFCNT_inc((SV *)av);
+  return arr;
+}
+
+//! Get a global hash variable
+//!
+//! Returns NULL if the variable doesn't exist. The caller must free the
+//! returned hash.
+ZEROPERL_API("zeroperl_get_hash_var")
+zeroperl_hash *zeroperl_get_hash_var(const char *name) {
+  if (!zero_perl || !zero_perl_can_evaluate || !name) {
+    return NULL;
+  }
+
+  dTHX;
+  HV *hv = get_hv(name, 0);
+
+  if (!hv) {
+    return NULL;
+  }
+
+  zeroperl_hash *hash = (zeroperl_hash *)zeroperl_handle_alloc();
+  if (!hash) {
+    return NULL;
+  }
+
+  hash->hv = (HV *)SvREFCNT_inc((SV *)hv);
+  return hash;
+}
+
+//! Set a global scalar variable
+//!
+//! Returns true on success, false on failure.
+ZEROPERL_API("zeroperl_set_var")
+bool zeroperl_set_var(const char *name, zeroperl_value *val) {
+  if (!zero_perl || !zero_perl_can_evaluate || !name || !val || !val->sv) {
+    return false;
+  }
+
+  dTHX;
+  SV *sv = get_sv(name, GV_ADD);
+
+  if (!sv) {
+    return false;
+  }
+
+  sv_setsv(sv, val->sv);
+  return true;
+}
+
+//! CBOR (RFC 8949) encoding of Perl data
+//!
+//! zeroperl_cbor_encode turns a whole SV graph into one buffer the host can
+//! decode in a single pass, and zeroperl_cbor_decode builds one back.
+//! Mapping: undef is null, booleans are false/true, strings are text strings
+//! when they are UTF-8 or plain ASCII and byte strings otherwise, so bytes
+//! round-trip exactly. A string that has also been used as a number stays a
+//! string. Integers are major types 0/1, other numbers float32 when exact,
+//! else float64. Array and hash references (blessed or not) are arrays and
+//! maps, tied hashes indefinite-length ones; scalar references encode their
+//! referent; code, glob and IO references cannot be encoded.
+#ifndef CBOR_MAX_DEPTH
+#define CBOR_MAX_DEPTH 512
+#endif
+
+typedef struct {
+  unsigned char *data;
+  size_t len;
+  size_t cap;
+} cbor_buf;
+
+//! Sets the error returned by zeroperl_last_error(); always false
+static bool cbor_fail(const char *what) {
+  snprintf(zero_perl_error_buf, sizeof(zero_perl_error_buf), "CBOR: %s",
+           what);
+  return false;
+}
+
+static bool cbor_reserve(cbor_buf *b, size_t n) {
+  if (b->cap - b->len >= n) {
+    return true;
+  }
+  size_t cap = b->cap ? b->cap : 256;
+  while (cap - b->len < n) {
+    cap *= 2;
+  }
+  unsigned char *data = (unsigned char *)realloc(b->data, cap);
+  if (!data) {
+    return false;
+  }
+  b->data = data;
+  b->cap = cap;
+  return true;
+}
+
+//! Writes an initial byte with major type major and argument v
+static bool cbor_put_head(cbor_buf *b, unsigned major, uint64_t v) {
+  if (!cbor_reserve(b, 9)) {
+    return false;
+  }
+  unsigned char *p = b->data + b->len;
+  major <<= 5;
+  if (v < 24) {
+    p[0] = (unsigned char)(major | v);
+    b->len += 1;
+  } else if (v <= 0xff) {
+    p[0] = (unsigned char)(major | 24);
+    p[1] = (unsigned char)v;
+    b->len += 2;
+  } else if (v <= 0xffff) {
+    p[0] = (unsigned char)(major | 25);
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)v;
+    b->len += 3;
+  } else if (v <= 0xffffffffu) {
+    p[0] = (unsigned char)(major | 26);
+    for (int i = 0; i < 4; i++) {
+      p[1 + i] = (unsigned char)(v >> (24 - 8 * i));
+    }
+    b->len += 5;
+  } else {
+    p[0] = (unsigned char)(major | 27);
+    for (int i = 0; i < 8; i++) {
+      p[1 + i] = (unsigned char)(v >> (56 - 8 * i));
+    }
+    b->len += 9;
+  }
+  return true;
+}
+
+static bool cbor_put_bytes(cbor_buf *b, const void *data, size_t len) {
+  if (!cbor_reserve(b, len)) {
+    return false;
+  }
+  memcpy(b->data + b->len, data, len);
+  b->len += len;
+  return true;
+}
+
+//! Writes a Perl string as a text string, or a byte string if it holds
+//! non-ASCII bytes without the UTF-8 flag
+static bool cbor_put_string(cbor_buf *b, const char *p, size_t len,
+                            bool utf8) {
+  unsigned major =
+      utf8 || is_utf8_invariant_string((const U8 *)p, len) ? 3 : 2;
+  return cbor_put_head(b, major, len) && cbor_put_bytes(b, p, len);
+}
+
+static bool cbor_put_double(cbor_buf *b, double d) {
+  unsigned char out[9];
+  float f = (float)d;
+  if ((double)f == d || d != d) {
+    uint32_t bits;
+    memcpy(&bits, &f, sizeof(bits));
+    out[0] = 0xfa;
+    for (int i = 0; i < 4; i++) {
+      out[1 + i] = (unsigned char)(bits >> (24 - 8 * i));
+    }
+    return cbor_put_bytes(b, out, 5);
+  }
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+  out[0] = 0xfb;
+  for (int i = 0; i < 8; i++) {
+    out[1 + i] = (unsigned char)(bits >> (56 - 8 * i));
+  }
+  return cbor_put_bytes(b, out, 9);
+}
+
+static bool cbor_encode_sv(pTHX_ cbor_buf *b, SV *sv, int depth);
+
+static bool cbor_encode_av(pTHX_ cbor_buf *b, AV *av, int depth) {
+  SSize_t count = av_top_index(av) + 1;
+  if (!cbor_put_head(b, 4, (uint64_t)count)) {
+    return false;
+  }
+  for (SSize_t i = 0; i < count; i++) {
+    SV **svp = av_fetch(av, i, 0);
+    if (!cbor_encode_sv(aTHX_ b, svp ? *svp : NULL, depth)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool cbor_encode_hv(pTHX_ cbor_buf *b, HV *hv, int depth) {
+  // Tied hashes only know their size by iterating, and may not give the
+  // same keys twice, so they are written in one pass as an indefinite-length
+  // map closed by a break
+  bool tied = SvRMAGICAL(hv);
+  uint64_t count = tied ? 0 : HvUSEDKEYS(hv);
+  bool ok = tied ? cbor_put_bytes(b, "\xbf", 1) : cbor_put_head(b, 5, count);
+  if (!ok) {
+    return false;
+  }
+
+  HE *he;
+  hv_iterinit(hv);
+  while ((tied || count-- > 0) && (he = hv_iternext(hv))) {
+    STRLEN klen;
+    const char *key = HePV(he, klen);
+    if (!cbor_put_string(b, key, klen, HeUTF8(he)) ||
+        !cbor_encode_sv(aTHX_ b, hv_iterval(hv, he), depth)) {
+      return false;
+    }
+  }
+  return !tied || cbor_put_bytes(b, "\xff", 1);
+}
+
+static bool cbor_encode_sv(pTHX_ cbor_buf *b, SV *sv, int depth) {
+  if (++depth > CBOR_MAX_DEPTH) {
+    return cbor_fail("data nested too deeply");
+  }
+
+  if (sv) {
+    SvGETMAGIC(sv);
+  }
+  if (!sv || !SvOK(sv)) {
+    return cbor_put_bytes(b, "\xf6", 1);
+  }
+
+#ifdef SvIsBOOL
+  if (SvIsBOOL(sv)) {
+    return cbor_put_bytes(b, SvTRUE_nomg(sv) ? "\xf5" : "\xf4", 1);
+  }
+#endif
+  if (sv == &PL_sv_yes || sv == &PL_sv_no) {
+    return cbor_put_bytes(b, sv == &PL_sv_yes ? "\xf5" : "\xf4", 1);
+  }
+
+  if (SvROK(sv)) {
+    SV *rv = SvRV(sv);
+    switch (SvTYPE(rv)) {
+    case SVt_PVAV:
+      return cbor_encode_av(aTHX_ b, (AV *)rv, depth);
+    case SVt_PVHV:
+      return cbor_encode_hv(aTHX_ b, (HV *)rv, depth);
+    case SVt_PVCV:
+    case SVt_PVGV:
+    case SVt_PVIO:
+    case SVt_PVFM:
+      snprintf(zero_perl_error_buf, sizeof(zero_perl_error_buf),
+               "CBOR: cannot encode a %s reference", sv_reftype(rv, 0));
+      return false;
+    default:
+      return cbor_encode_sv(aTHX_ b, rv, depth);
+    }
+  }
+
+  if (SvPOK(sv)) {
+    STRLEN len;
+    const char *p = SvPV_nomg_const(sv, len);
+    return cbor_put_string(b, p, len, SvUTF8(sv));
+  }
+
+  if (SvIOK(sv)) {
+    if (SvIsUV(sv)) {
+      return cbor_put_head(b, 0, (uint64_t)SvUVX(sv));
+    }
+    IV iv = SvIVX(sv);
+    return iv >= 0 ? cbor_put_head(b, 0, (uint64_t)iv)
+                   : cbor_put_head(b, 1, (uint64_t)(-1 - iv));
+  }
+
+  if (SvNOK(sv)) {
+    return cbor_put_double(b, (double)SvNVX(sv));
+  }
+
+  STRLEN len;
+  const char *p = SvPV_nomg_const(sv, len);
+  return cbor_put_string(b, p, len, SvUTF8(sv));
+}
+
+//! Encode a value as CBOR
+//!
+//! Returns a malloc'd buffer holding one CBOR data item and stores its size
+//! in out_len; the caller frees it with free(). Returns NULL on failure, with
+//! the reason in zeroperl_last_error().
+ZEROPERL_API("zeroperl_cbor_encode")
+void *zeroperl_cbor_encode(zeroperl_value *val, size_t *out_len) {
+  if (!zero_perl || !zero_perl_can_evaluate || !val || !out_len) {
+    return NULL;
+  }
+
+  dTHX;
+  zero_perl_error_buf[0] = '\0';
+  cbor_buf b = {NULL, 0, 0};
+  if (!cbor_encode_sv(aTHX_ &b, val->sv, 0)) {
+    if (zero_perl_error_buf[0] == '\0') {
+      cbor_fail("out of memory");
+    }
+    free(b.data);
+    return NULL;
+  }
+
+  *out_len = b.len;
+  return b.data;
+}
+
+typedef struct {
+  const unsigned char *p;
+  const unsigned char *end;
+} cbor_reader;
+
+//! Reads an initial byte; ai 31 (indefinite length) is left in *ai
+static bool cbor_get_head(cbor_reader *r, unsigned *major, unsigned *ai,
+                          uint64_t *v) {
+  if (r->p >= r->end) {
+    return cbor_fail("unexpected end of data");
+  }
+  unsigned ib = *r->p++;
+  *major = ib >> 5;
+  *ai = ib & 0x1f;
+  if (*ai < 24) {
+    *v = *ai;
+    return true;
+  }
+  if (*ai == 31) {
+    *v = 0;
+    return true;
+  }
+  if (*ai > 27) {
+    return cbor_fail("reserved additional information");
+  }
+  size_t n = (size_t)1 << (*ai - 24);
+  if ((size_t)(r->end - r->p) < n) {
+    return cbor_fail("unexpected end of data");
+  }
+  *v = 0;
+  for (size_t i = 0; i < n; i++) {
+    *v = (*v << 8) | *r->p++;
+  }
+  return true;
+}
+
+//! Whether the next byte is the break that ends an indefinite item
+static bool cbor_at_break(cbor_reader *r) {
+  if (r->p < r->end && *r->p == 0xff) {
+    r->p++;
+    return true;
+  }
+  return false;
+}
+
+static double cbor_half(uint16_t h) {
+  int exp = (h >> 10) & 0x1f;
+  double mant = h & 0x3ff;
+  double d;
+  if (exp == 0) {
+    d = ldexp(mant, -24);
+  } else if (exp == 31) {
+    d = mant == 0 ? INFINITY : NAN;
+  } else {
+    d = ldexp(mant + 1024, exp - 25);
+  }
+  return (h & 0x8000) ? -d : d;
+}
+
+//! Reads a text or byte string of the given major type into sv
+static bool cbor_decode_string(pTHX_ cbor_reader *r, unsigned major,
+                               unsigned ai, uint64_t len, SV *sv) {
+  if (ai != 31) {
+    if (len > (uint64_t)(r->end - r->p)) {
+      return cbor_fail("unexpected end of data");
+    }
+    // Each chunk of an indefinite-length text string is valid on its own
+    bool ascii;
+    if (major == 3 && !zeroperl_utf8_validate(r->p, (size_t)len, &ascii)) {
+      return cbor_fail("invalid UTF-8 in text string");
+    }
+    sv_catpvn(sv, (const char *)r->p, (STRLEN)len);
+    r->p += len;
+  } else {
+    while (!cbor_at_break(r)) {
+      unsigned cmajor, cai;
+      uint64_t clen;
+      if (!cbor_get_head(r, &cmajor, &cai, &clen)) {
+        return false;
+      }
+      if (cmajor != major || cai == 31) {
+        return cbor_fail("bad chunk in indefinite-length string");
+      }
+      if (!cbor_decode_string(aTHX_ r, major, cai, clen, sv)) {
+        return false;
+      }
+    }
+  }
+  if (major == 3) {
+    SvUTF8_on(sv);
+  }
+  return true;
+}
+
+static SV *cbor_decode_sv(pTHX_ cbor_reader *r, int depth);
+
+static SV *cbor_decode_map(pTHX_ cbor_reader *r, unsigned ai, uint64_t count,
+                           int depth) {
+  HV *hv = newHV();
+  SV *rv = newRV_noinc((SV *)hv);
+  for (uint64_t i = 0; ai == 31 || i < count; i++) {
+    if (ai == 31 && cbor_at_break(r)) {
+      break;
+    }
+    SV *key = cbor_decode_sv(aTHX_ r, depth);
+    if (!key) {
+      SvREFCNT_dec(rv);
+      return NULL;
+    }
+    if (SvROK(key) || !SvOK(key)) {
+      SvREFCNT_dec(key);
+      SvREFCNT_dec(rv);
+      cbor_fail("map keys must be strings or numbers");
+      return NULL;
+    }
+    SV *val = cbor_decode_sv(aTHX_ r, depth);
+    if (!val) {
+      SvREFCNT_dec(key);
+      SvREFCNT_dec(rv);
+      return NULL;
+    }
+    hv_store_ent(hv, key, val, 0);
+    SvREFCNT_dec(key);
+  }
+  return rv;
+}
+
+static SV *cbor_decode_array(pTHX_ cbor_reader *r, unsigned ai,
+                             uint64_t count, int depth) {
+  // Each element takes at least one byte, which bounds the preallocation
+  if (ai != 31 && count > (uint64_t)(r->end - r->p)) {
+    cbor_fail("unexpected end of data");
+    return NULL;
+  }
+  AV *av = newAV();
+  SV *rv = newRV_noinc((SV *)av);
+  if (ai != 31 && count > 0) {
+    av_extend(av, (SSize_t)count - 1);
+  }
+  for (uint64_t i = 0; ai == 31 || i < count; i++) {
+    if (ai == 31 && cbor_at_break(r)) {
+      break;
+    }
+    SV *val = cbor_decode_sv(aTHX_ r, depth);
+    if (!val) {
+      SvREFCNT_dec(rv);
+      return NULL;
+    }
+    av_push(av, val);
+  }
+  return rv;
+}
+
+static SV *cbor_decode_sv(pTHX_ cbor_reader *r, int depth) {
+  if (++depth > CBOR_MAX_DEPTH) {
+    cbor_fail("data nested too deeply");
+    return NULL;
+  }
+
+  unsigned major, ai;
+  uint64_t v;
+  if (!cbor_get_head(r, &major, &ai, &v)) {
+    return NULL;
+  }
+  if (ai == 31 && (major < 2 || major == 6)) {
+    cbor_fail("indefinite length on a non-container");
+    return NULL;
+  }
+
+  switch (major) {
+  case 0:
+    return v <= (uint64_t)IV_MAX ? newSViv((IV)v) : newSVuv((UV)v);
+  case 1:
+    return v <= (uint64_t)IV_MAX ? newSViv(-1 - (IV)v)
+                                 : newSVnv(-1.0 - (NV)v);
+  case 2:
+  case 3: {
+    // Definite-length text is validated and flagged like any host string
+    if (major == 3 && ai != 31) {
+      if (v > (uint64_t)(r->end - r->p)) {
+        cbor_fail("unexpected end of data");
+        return NULL;
+      }
+      SV *sv = zeroperl_new_utf8_sv(aTHX_ (const char *)r->p, (size_t)v);
+      if (!sv) {
+        cbor_fail("invalid UTF-8 in text string");
+        return NULL;
+      }
+      r->p += v;
+      return sv;
+    }
+    SV *sv = newSVpvs("");
+    if (!cbor_decode_string(aTHX_ r, major, ai, v, sv)) {
+      SvREFCNT_dec(sv);
+      return NULL;
+    }
+    return sv;
+  }
+  case 4:
+    return cbor_decode_array(aTHX_ r, ai, v, depth);
+  case 5:
+    return cbor_decode_map(aTHX_ r, ai, v, depth);
+  case 6:
+    // Tags carry no meaning for Perl data; decode the tagged item
+    return cbor_decode_sv(aTHX_ r, depth);
+  default:
+    switch (ai) {
+    case 20:
+      return newSVsv(&PL_sv_no);
+    case 21:
+      return newSVsv(&PL_sv_yes);
+    case 22:
+    case 23:
+      return newSV(0);
+    case 25:
+      return newSVnv(cbor_half((uint16_t)v));
+    case 26: {
+      uint32_t bits = (uint32_t)v;
+      float f;
+      memcpy(&f, &bits, sizeof(f));
+      return newSVnv(f);
+    }
+    case 27: {
+      double d;
+      memcpy(&d, &v, sizeof(d));
+      return newSVnv(d);
+    }
+    default:
+      cbor_fail(ai == 31 ? "unexpected break" : "unsupported simple value");
+      return NULL;
+    }
+  }
+}
+
+//! Decode a CBOR data item into a value
 //!
-//! Returns NULL if the variable doesn't exist. The caller must free the
-//! returned value.
-ZEROPERL_API("zeroperl_get_var")
-zeroperl_value *zeroperl_get_var(const char *name) {
-  if (!zero_perl || !zero_perl_can_evaluate || !name) {
+//! data must hold exactly one item. Maps become hash references, arrays
+//! array references, text strings UTF-8 strings and byte strings plain
+//! ones; tags are ignored. Returns NULL on malformed input, with the reason
+//! in zeroperl_last_error(). The caller must free the returned value.
+ZEROPERL_API("zeroperl_cbor_decode")
+zeroperl_value *zeroperl_cbor_decode(const void *data, size_t len) {
+  if (!zero_perl || !zero_perl_can_evaluate || (!data && len > 0)) {
     return NULL;
   }
 
   dTHX;
-  SV *sv = get_sv(name, 0);
-
+  zero_perl_error_buf[0] = '\0';
+  cbor_reader r = {(const unsigned char *)data,
+                   (const unsigned char *)data + len};
+  SV *sv = cbor_decode_sv(aTHX_ &r, 0);
   if (!sv) {
     return NULL;
   }
+  if (r.p != r.end) {
+    SvREFCNT_dec(sv);
+    cbor_fail("trailing data after the first item");
+    return NULL;
+  }
 
-  zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
+  zeroperl_value *val = (zeroperl_value *)zeroperl_handle_alloc();
   if (!val) {
+    SvREFCNT_dec(sv);
     return NULL;
   }
 
-  val->sv = SvREFCNT_inc(sv);
+  val->sv = sv;
   return val;
 }
 
-//! Get a global array variable
+//! Parses a host signature such as "iid>s" into entry
 //!
-//! Returns NULL if the variable doesn't exist. The caller must free the
-//! returned array.
-ZEROPERL_API("zeroperl_get_array_var")
-zeroperl_array *zeroperl_get_array_var(const char *name) {
-  if (!zero_perl || !zero_perl_can_evaluate || !name) {
-    return NULL;
+//! Argument types come before the '>', the result type after it; no '>'
+//! means no result. Returns false if the signature is malformed.
+static bool host_signature_parse(const char *signature,
+                                 host_function_entry *entry) {
+  const char *arrow = strchr(signature, '>');
+  size_t nargs = arrow ? (size_t)(arrow - signature) : strlen(signature);
+  if (nargs >= HOST_FRAME_SLOTS || strspn(signature, "ilds") != nargs) {
+    return false;
   }
 
-  dTHX;
-  AV *av = get_av(name, 0);
-
-  if (!av) {
-    return NULL;
+  char ret_type = 'v';
+  if (arrow) {
+    if (strlen(arrow + 1) != 1 || !strchr("ildsv", arrow[1])) {
+      return false;
+    }
+    ret_type = arrow[1];
   }
 
-  zeroperl_array *arr = (zeroperl_array *)malloc(sizeof(zeroperl_array));
-  if (!arr) {
-    return NULL;
+  entry->arg_types = strndup(signature, nargs);
+  if (!entry->arg_types) {
+    return false;
   }
-
-  arr->av = (AV *)SvREFCNT_inc((SV *)av);
-  return arr;
+  entry->nargs = (int)nargs;
+  entry->ret_type = ret_type;
+  return true;
 }
 
-//! Get a global hash variable
-//!
-//! Returns NULL if the variable doesn't exist. The caller must free the
-//! returned hash.
-ZEROPERL_API("zeroperl_get_hash_var")
-zeroperl_hash *zeroperl_get_hash_var(const char *name) {
-  if (!zero_perl || !zero_perl_can_evaluate || !name) {
-    return NULL;
+//! Shared part of zeroperl_register_function and zeroperl_register_method
+static void zeroperl_register_host(int32_t func_id, const char *full_name,
+                                   const char *name, const char *package,
+                                   int flags, const char *signature) {
+  if (host_function_count >= MAX_HOST_FUNCTIONS) {
+    return;
   }
 
-  dTHX;
-  HV *hv = get_hv(name, 0);
-
-  if (!hv) {
-    return NULL;
+  host_function_entry *entry = &host_functions[host_function_count];
+  memset(entry, 0, sizeof(*entry));
+  if (signature && !host_signature_parse(signature, entry)) {
+    snprintf(zero_perl_error_buf, sizeof(zero_perl_error_buf),
+             "Invalid host function signature \"%s\" for %s", signature,
+             full_name);
+    return;
   }
 
-  zeroperl_hash *hash = (zeroperl_hash *)malloc(sizeof(zeroperl_hash));
-  if (!hash) {
-    return NULL;
-  }
+  dTHX;
 
-  hash->hv = (HV *)SvREFCNT_inc((SV *)hv);
-  return hash;
-}
+  bool sync = (flags & ZEROPERL_HOST_SYNC) != 0;
+  XSUBADDR_t xsub;
+  if (signature) {
+    xsub = sync ? xs_host_dispatch_typed_sync : xs_host_dispatch_typed;
+  } else {
+    xsub = sync ? xs_host_dispatch_sync : xs_host_dispatch;
+  }
 
-//! Set a global scalar variable
-//!
-//! Returns true on success, false on failure.
-ZEROPERL_API("zeroperl_set_var")
-bool zeroperl_set_var(const char *name, zeroperl_value *val) {
-  if (!zero_perl || !zero_perl_can_evaluate || !name || !val || !val->sv) {
-    return false;
+  CV *cv = newXS(full_name, xsub, __FILE__);
+  if (!cv) {
+    free(entry->arg_types);
+    return;
   }
 
-  dTHX;
-  SV *sv = get_sv(name, GV_ADD);
+  entry->func_id = func_id;
+  entry->name = strdup(name);
+  entry->package = package ? strdup(package) : NULL;
+  entry->is_method = package != NULL;
+  entry->is_sync = sync;
+  host_function_count++;
 
-  if (!sv) {
-    return false;
+  if (signature) {
+    CvXSUBANY(cv).any_ptr = entry;
+  } else {
+    CvXSUBANY(cv).any_i32 = func_id;
   }
-
-  sv_setsv(sv, val->sv);
-  return true;
 }
 
 //! Register a host function that can be called from Perl
@@ -2003,24 +5438,53 @@ void zeroperl_register_function(int32_t func_id, const char *name) {
     return;
   }
 
-  if (host_function_count >= MAX_HOST_FUNCTIONS) {
+  zeroperl_register_host(func_id, name, name, NULL, ZEROPERL_HOST_SUSPENDING,
+                         NULL);
+}
+
+//! Register a host function with flags and an optional signature
+//!
+//! As zeroperl_register_function, but calls call_host_function_sync if flags
+//! has ZEROPERL_HOST_SYNC. Sync functions must not suspend; their call is not
+//! an Asyncify unwind point, so use them for anything that returns
+//! immediately.
+//!
+//! With a signature such as "iid>s" the arguments are converted in place of
+//! being passed as zeroperl_value handles: i is an int32, l an int64, d a
+//! double and s a UTF-8 string, with the result type after the '>' ('v' or
+//! no '>' for none). The host is then called through
+//! call_host_function_typed(_sync) with a frame of 8-byte slots, one per
+//! argument and one for the result; a string is a (ptr, len) pair of
+//! uint32s, and a string result must be malloc'd (zeroperl frees it) or have
+//! a NULL ptr for undef. The sub dies if called with a different number of
+//! arguments. An invalid signature registers nothing and sets the error
+//! returned by zeroperl_last_error.
+ZEROPERL_API("zeroperl_register_function_ex")
+void zeroperl_register_function_ex(int32_t func_id, const char *name,
+                                   int flags, const char *signature) {
+  if (!zero_perl || !zero_perl_can_evaluate || !name) {
     return;
   }
 
-  dTHX;
+  zeroperl_register_host(func_id, name, name, NULL, flags, signature);
+}
 
-  CV *cv = newXS(name, xs_host_dispatch, __FILE__);
-  if (!cv) {
+//! Register a host method with flags and an optional signature
+//!
+//! flags and signature are as for zeroperl_register_function_ex, with the
+//! invocant as the first argument.
+ZEROPERL_API("zeroperl_register_method_ex")
+void zeroperl_register_method_ex(int32_t func_id, const char *package,
+                                 const char *method, int flags,
+                                 const char *signature) {
+  if (!zero_perl || !zero_perl_can_evaluate || !package || !method) {
     return;
   }
 
-  CvXSUBANY(cv).any_i32 = func_id;
-
-  host_function_entry *entry = &host_functions[host_function_count++];
-  entry->func_id = func_id;
-  entry->name = strdup(name);
-  entry->package = NULL;
-  entry->is_method = false;
+  char full_name[256];
+  snprintf(full_name, sizeof(full_name), "%s::%s", package, method);
+  zeroperl_register_host(func_id, full_name, method, package, flags,
+                         signature);
 }
 
 //! Register a host method that can be called from Perl
@@ -2031,31 +5495,8 @@ void zeroperl_register_function(int32_t func_id, const char *name) {
 ZEROPERL_API("zeroperl_register_method")
 void zeroperl_register_method(int32_t func_id, const char *package,
                               const char *method) {
-  if (!zero_perl || !zero_perl_can_evaluate || !package || !method) {
-    return;
-  }
-
-  if (host_function_count >= MAX_HOST_FUNCTIONS) {
-    return;
-  }
-
-  dTHX;
-
-  char full_name[256];
-  snprintf(full_name, sizeof(full_name), "%s::%s", package, method);
-
-  CV *cv = newXS(full_name, xs_host_dispatch, __FILE__);
-  if (!cv) {
-    return;
-  }
-
-  CvXSUBANY(cv).any_i32 = func_id;
-
-  host_function_entry *entry = &host_functions[host_function_count++];
-  entry->func_id = func_id;
-  entry->name = strdup(method);
-  entry->package = strdup(package);
-  entry->is_method = true;
+  zeroperl_register_method_ex(func_id, package, method,
+                              ZEROPERL_HOST_SUSPENDING, NULL);
 }
 
 //! Internal callback for calling Perl subroutines
@@ -2078,9 +5519,15 @@ static int zeroperl_call_callback(int argc, char **argv) {
 
   PUSHMARK(SP);
 
-  for (int i = 0; i < ctx->data.call.argc; i++) {
-    if (ctx->data.call.argv[i] && ctx->data.call.argv[i]->sv) {
-      XPUSHs(sv_2mortal(SvREFCNT_inc(ctx->data.call.argv[i]->sv)));
+  if (ctx->data.call.strv) {
+    for (int i = 0; i < ctx->data.call.argc; i++) {
+      XPUSHs(sv_2mortal(newSVpv(ctx->data.call.strv[i], 0)));
+    }
+  } else {
+    for (int i = 0; i < ctx->data.call.argc; i++) {
+      if (ctx->data.call.argv[i] && ctx->data.call.argv[i]->sv) {
+        XPUSHs(sv_2mortal(SvREFCNT_inc(ctx->data.call.argv[i]->sv)));
+      }
     }
   }
 
@@ -2100,7 +5547,9 @@ static int zeroperl_call_callback(int argc, char **argv) {
     break;
   }
 
-  int count = call_pv(ctx->data.call.name, gimme | G_EVAL);
+  int count = ctx->data.call.sv
+                  ? call_sv(ctx->data.call.sv, gimme | G_EVAL)
+                  : call_pv(ctx->data.call.name, gimme | G_EVAL);
 
   SPAGAIN;
 
@@ -2134,6 +5583,8 @@ static int zeroperl_call_callback(int argc, char **argv) {
       return -1;
     }
 
+    // The result owns its values and may outlive the current handle scope,
+    // so they are never scoped handles
     for (int i = count - 1; i >= 0; i--) {
       zeroperl_value *val = (zeroperl_value *)malloc(sizeof(zeroperl_value));
       if (val) {
@@ -2173,7 +5624,7 @@ zeroperl_result *zeroperl_call(const char *name, zeroperl_context_type context,
       .data.call = {
           .name = name, .argc = argc, .argv = argv, .context = context}};
 
-  int status = asyncjmp_rt_start(zeroperl_call_callback, 0, (char **)&ctx);
+  int status = zeroperl_run(zeroperl_call_callback, &ctx);
 
   if (status != 0) {
     return NULL;
@@ -2216,6 +5667,220 @@ void zeroperl_result_free(zeroperl_result *result) {
   free(result);
 }
 
+//! Internal callback for compiling source into an anonymous sub
+static int zeroperl_compile_callback(int argc, char **argv) {
+  (void)argc;
+  zeroperl_context *ctx = (zeroperl_context *)argv;
+
+  if (!zero_perl || !zero_perl_can_evaluate) {
+    ctx->result = -1;
+    return -1;
+  }
+
+  zeroperl_clear_error_internal();
+
+  dTHX;
+  dSP;
+
+  ENTER;
+  SAVETMPS;
+
+  // The body shares the first line with "sub {" so line numbers in
+  // warnings and errors match the caller's source
+  SV *src = sv_2mortal(newSVpvs("sub { "));
+  sv_catpv(src, ctx->data.compile.code);
+  sv_catpvs(src, "\n}");
+
+  PUSHMARK(SP);
+  int count = eval_sv(src, G_SCALAR);
+  SPAGAIN;
+  SV *ref = count > 0 ? POPs : &PL_sv_undef;
+  PUTBACK;
+
+  if (SvTRUE(ERRSV) || !SvROK(ref) || SvTYPE(SvRV(ref)) != SVt_PVCV) {
+    zeroperl_capture_error();
+    ctx->result = -1;
+  } else {
+    ctx->data.compile.out->cv = (CV *)SvREFCNT_inc(SvRV(ref));
+    ctx->result = 0;
+  }
+
+  FREETMPS;
+  LEAVE;
+
+  return ctx->result;
+}
+
+//! Compile Perl source once for repeated zeroperl_exec() calls
+//!
+//! The source becomes the body of an anonymous sub, so it is parsed here
+//! and never again; arguments passed to zeroperl_exec() arrive in @_.
+//!
+//! Returns a code handle to free with zeroperl_code_free(), or NULL on a
+//! compile error (see zeroperl_last_error()).
+ZEROPERL_API("zeroperl_compile")
+zeroperl_code *zeroperl_compile(const char *code) {
+  if (!zero_perl || !zero_perl_can_evaluate || !code) {
+    return NULL;
+  }
+
+  zeroperl_code *handle = (zeroperl_code *)malloc(sizeof(zeroperl_code));
+  if (!handle) {
+    return NULL;
+  }
+  handle->cv = NULL;
+
+  zeroperl_context ctx = {
+      .op_type = ZEROPERL_OP_COMPILE,
+      .result = 0,
+      .data.compile = {.code = code, .out = handle}};
+
+  int status = zeroperl_run(zeroperl_compile_callback, &ctx);
+
+  if (status != 0 || !handle->cv) {
+    free(handle);
+    return NULL;
+  }
+
+  return handle;
+}
+
+//! Run code compiled with zeroperl_compile()
+//!
+//! The string arguments are passed in @_. Returns a result structure holding
+//! the return values in the requested context; the caller must free it with
+//! zeroperl_result_free(). Returns NULL on error (see zeroperl_last_error()).
+ZEROPERL_API("zeroperl_exec")
+zeroperl_result *zeroperl_exec(zeroperl_code *code,
+                               zeroperl_context_type context, int argc,
+                               char **argv) {
+  if (!zero_perl || !zero_perl_can_evaluate || !code || !code->cv) {
+    return NULL;
+  }
+
+  zeroperl_context ctx = {
+      .op_type = ZEROPERL_OP_CALL,
+      .result = 0,
+      .data.call = {.sv = (SV *)code->cv,
+                    .argc = argv ? argc : 0,
+                    .strv = argv,
+                    .context = context}};
+
+  int status = zeroperl_run(zeroperl_call_callback, &ctx);
+
+  if (status != 0) {
+    return NULL;
+  }
+
+  return *((zeroperl_result **)&ctx.result);
+}
+
+//! Free a code handle
+//!
+//! Decrements the reference count of the sub and frees the handle structure.
+ZEROPERL_API("zeroperl_code_free")
+void zeroperl_code_free(zeroperl_code *code) {
+  if (!code) {
+    return;
+  }
+
+  if (code->cv) {
+    dTHX;
+    SvREFCNT_dec((SV *)code->cv);
+  }
+
+  free(code);
+}
+
+//! Resolve a named subroutine once for repeated zeroperl_call_code() calls
+//!
+//! The name is looked up in its stash here rather than on every call. The
+//! handle keeps the sub alive even if it is later redefined or deleted.
+//!
+//! Returns NULL if no such sub is defined. The caller must free the
+//! returned handle with zeroperl_code_free().
+ZEROPERL_API("zeroperl_resolve_sub")
+zeroperl_code *zeroperl_resolve_sub(const char *name) {
+  if (!zero_perl || !zero_perl_can_evaluate || !name) {
+    return NULL;
+  }
+
+  dTHX;
+
+  CV *cv = get_cv(name, 0);
+  if (!cv) {
+    return NULL;
+  }
+
+  zeroperl_code *code = (zeroperl_code *)malloc(sizeof(zeroperl_code));
+  if (!code) {
+    return NULL;
+  }
+
+  code->cv = (CV *)SvREFCNT_inc((SV *)cv);
+  return code;
+}
+
+//! Convert a value to a code handle
+//!
+//! Returns NULL if the value is not a code reference. The caller must free
+//! the returned handle with zeroperl_code_free().
+ZEROPERL_API("zeroperl_value_to_code")
+zeroperl_code *zeroperl_value_to_code(zeroperl_value *val) {
+  if (!val || !val->sv) {
+    return NULL;
+  }
+
+  dTHX;
+
+  if (!SvROK(val->sv)) {
+    return NULL;
+  }
+
+  SV *rv = SvRV(val->sv);
+  if (SvTYPE(rv) != SVt_PVCV) {
+    return NULL;
+  }
+
+  zeroperl_code *code = (zeroperl_code *)malloc(sizeof(zeroperl_code));
+  if (!code) {
+    return NULL;
+  }
+
+  code->cv = (CV *)SvREFCNT_inc(rv);
+  return code;
+}
+
+//! Call a resolved sub or closure
+//!
+//! Like zeroperl_call() but invokes the CV directly with call_sv, with no
+//! symbol lookup. Returns a result structure containing the return values;
+//! the caller must free it with zeroperl_result_free().
+ZEROPERL_API("zeroperl_call_code")
+zeroperl_result *zeroperl_call_code(zeroperl_code *code,
+                                    zeroperl_context_type context, int argc,
+                                    zeroperl_value **argv) {
+  if (!zero_perl || !zero_perl_can_evaluate || !code || !code->cv) {
+    return NULL;
+  }
+
+  zeroperl_context ctx = {
+      .op_type = ZEROPERL_OP_CALL,
+      .result = 0,
+      .data.call = {.sv = (SV *)code->cv,
+                    .argc = argv ? argc : 0,
+                    .argv = argv,
+                    .context = context}};
+
+  int status = zeroperl_run(zeroperl_call_callback, &ctx);
+
+  if (status != 0) {
+    return NULL;
+  }
+
+  return *((zeroperl_result **)&ctx.result);
+}
+
 EXTERN_C void boot_DynaLoader(pTHX_ CV *cv);
 EXTERN_C void boot_File__Glob(pTHX_ CV *cv);
 EXTERN_C void boot_Sys__Hostname(pTHX_ CV *cv);
@@ -2253,6 +5918,7 @@ EXTERN_C void boot_List__Util(pTHX_ CV *cv);
 EXTERN_C void boot_Fcntl(pTHX_ CV *cv);
 EXTERN_C void boot_Opcode(pTHX_ CV *cv);
 EXTERN_C void boot_Time__HiRes(pTHX_ CV* cv);
+EXTERN_C void boot_ZeroPerl__JSON(pTHX_ CV *cv);
 
 static void xs_init(pTHX) {
   static const char file[] = __FILE__;
@@ -2260,6 +5926,8 @@ static void xs_init(pTHX) {
   PERL_UNUSED_CONTEXT;
 
   newXS("DynaLoader::boot_DynaLoader", boot_DynaLoader, file);
+  sfs_perlio_init(aTHX);
+  sfs_inc_hook_init(aTHX);
   newXS("File::Glob::bootstrap", boot_File__Glob, file);
   newXS("Sys::Hostname::bootstrap", boot_Sys__Hostname, file);
   newXS("PerlIO::via::bootstrap", boot_PerlIO__via, file);
@@ -2296,6 +5964,7 @@ static void xs_init(pTHX) {
   newXS("Fcntl::bootstrap", boot_Fcntl, file);
   newXS("Opcode::bootstrap", boot_Opcode, file);
   newXS("Time::HiRes::bootstrap", boot_Time__HiRes, file);
+  newXS("ZeroPerl::JSON::bootstrap", boot_ZeroPerl__JSON, file);
 }
 
 // Async Web API functions
@@ -2351,11 +6020,19 @@ bool async_wait_for_completion(int32_t op_id) {
     async_state_t state;
     do {
         // Check if JavaScript has resolved any pending operations
-        js_async_resolve_pending();
+        bool progressed = js_async_resolve_pending();
         
         // Check our operation state
         state = async_get_operation_state(op_id, NULL, NULL, NULL);
         
+#ifdef WASM_SETJMP_EH
+        // Without Asyncify there is no way to yield to JavaScript, so only
+        // operations the host settles synchronously can complete
+        if (state == ASYNC_STATE_PENDING && !progressed) {
+            break;
+        }
+#else
+        (void)progressed;
         if (state == ASYNC_STATE_PENDING) {
             // If still pending, yield control back to JavaScript
             // This will be handled by the asyncify mechanism
@@ -2366,6 +6043,7 @@ bool async_wait_for_completion(int32_t op_id) {
             }
             // When JavaScript resolves the operation, it will rewind here
         }
+#endif
         
     } while (state == ASYNC_STATE_PENDING);
     
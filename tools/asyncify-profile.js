@@ -0,0 +1,302 @@
+#!/usr/bin/env node
+
+// Profile-guided Asyncify lists (ASYNCIFY_PROFILE in build-wasm.sh).
+//
+// record: run the workloads in tools/profile on a fully instrumented copy of
+// the shipped reactor. It is built with -DASYNCJMP_PROFILE, so once
+// asyncjmp_profile_enable() is called every asyncify_start_unwind first
+// writes to PROFILE_FD. That write and the asyncify-imports
+// (call_host_function(_typed), fd_read) capture the wasm call stack; every function
+// between the unwinding call and the asyncjmp_rt_start root frame has to be
+// instrumented, and the union of those is written as an asyncify-onlylist.
+//
+// The runtime functions themselves (the caller of start_unwind, the root
+// frame and the try/catch loop) are left out, as Binaryen never instruments
+// them. Frames above the root are left out as well, since no unwind passes
+// asyncjmp_rt_start.
+//
+// The async Web API exports call their asyncify imports straight from the
+// host, outside asyncjmp_rt_start, and AsyncWebAPI is not linked into the
+// interpreter, so no workload reaches them; ASYNC_EXPORTS are always listed.
+// The *_sync imports never suspend and need no stacks.
+//
+// compare: run the same workloads on two builds and report size and time.
+
+const fs = require('node:fs');
+const path = require('node:path');
+const { WASI } = require('node:wasi');
+
+const args = process.argv.slice(2);
+const mode = args.shift();
+let inputPath = '';
+let outputPath = '';
+let workloadDir = '';
+let runs = 5;
+const positional = [];
+
+function usage() {
+    console.error(`Usage: asyncify-profile.js record -i <profile.wasm> -w <workloads> -o <onlylist.txt>
+       asyncify-profile.js compare -w <workloads> [-n <runs>] <baseline.wasm> <candidate.wasm>`);
+    process.exit(1);
+}
+
+for (let i = 0; i < args.length; i++) {
+    const arg = args[i];
+    if (arg === '-i') inputPath = args[++i];
+    else if (arg === '-o') outputPath = args[++i];
+    else if (arg === '-w') workloadDir = args[++i];
+    else if (arg === '-n') runs = Number(args[++i]);
+    else if (arg.startsWith('-')) usage();
+    else positional.push(arg);
+}
+if (!workloadDir) usage();
+if (mode === 'record' && (!inputPath || !outputPath)) usage();
+else if (mode === 'compare' && positional.length !== 2) usage();
+else if (mode !== 'record' && mode !== 'compare') usage();
+
+const ROOT_FRAME = 'asyncjmp_rt_start';
+const RUNTIME_FRAMES = new Set([ROOT_FRAME, 'asyncjmp_try_catch_loop_run']);
+const REPORT_FRAME = 'asyncjmp_profile_report';
+const ASYNC_EXPORTS = ['async_fetch', 'async_timer', 'async_wait_for_completion'];
+// Matches ASYNCJMP_PROFILE_FD in stubs/runtime.c
+const PROFILE_FD = 0x7ffffffe;
+const HOST_FUNCTION_ID = 1;
+const MOUNT_DIR = '/zeroperl-profile';
+const ZEROPERL_VOID = 0, ZEROPERL_SCALAR = 1;
+const ZEROPERL_SFS_COPY = 1;
+const ZEROPERL_HOST_SUSPENDING = 0;
+
+function readU32(buf, pos) {
+    let result = 0, shift = 0, byte;
+    do {
+        byte = buf[pos++];
+        result |= (byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return [result >>> 0, pos];
+}
+
+// Function names from the "name" custom section, by function index (which
+// is also what V8 prints as wasm-function[N])
+function functionNames(bytes) {
+    const names = new Map();
+    let pos = 8;
+    while (pos < bytes.length) {
+        const id = bytes[pos++];
+        let size;
+        [size, pos] = readU32(bytes, pos);
+        const end = pos + size;
+        if (id === 0) {
+            let len, p;
+            [len, p] = readU32(bytes, pos);
+            if (bytes.subarray(p, p + len).toString('utf8') === 'name') {
+                p += len;
+                while (p < end) {
+                    const sub = bytes[p++];
+                    let subSize;
+                    [subSize, p] = readU32(bytes, p);
+                    if (sub === 1) {
+                        let count, q = p;
+                        [count, q] = readU32(bytes, q);
+                        for (let i = 0; i < count; i++) {
+                            let index, nameLen;
+                            [index, q] = readU32(bytes, q);
+                            [nameLen, q] = readU32(bytes, q);
+                            names.set(index, bytes.subarray(q, q + nameLen).toString('utf8'));
+                            q += nameLen;
+                        }
+                    }
+                    p += subSize;
+                }
+            }
+        }
+        pos = end;
+    }
+    return names;
+}
+
+function workloads() {
+    return fs.readdirSync(workloadDir)
+        .filter(name => name.endsWith('.pl'))
+        .sort()
+        .map(name => ({ name, source: fs.readFileSync(path.join(workloadDir, name)) }));
+}
+
+// Instantiates a build and runs every workload through each entry point
+// that starts Perl code: run_file, eval, call, compile/exec and call_code.
+// hooks.onStack(skipRuntime) is called from the unwind report and the
+// asyncify imports.
+function run(wasmPath, hooks = {}) {
+    const wasmModule = new WebAssembly.Module(fs.readFileSync(wasmPath));
+    const wasi = new WASI({ version: 'preview1', env: {}, args: ['zeroperl'] });
+    const onStack = hooks.onStack || (() => {});
+    const imports = {
+        wasi_snapshot_preview1: {
+            ...wasi.wasiImport,
+            fd_read: (...a) => {
+                onStack(false);
+                return wasi.wasiImport.fd_read(...a);
+            },
+            fd_write: (fd, ...a) => {
+                if (fd !== PROFILE_FD) return wasi.wasiImport.fd_write(fd, ...a);
+                onStack(true);
+                return 0;
+            },
+        },
+    };
+    const env = {
+        call_host_function: () => {
+            onStack(false);
+            return 0;
+        },
+        call_host_function_typed: () => onStack(false),
+        call_host_function_sync: () => 0,
+        call_host_function_typed_sync: () => {},
+        js_async_fetch: () => {
+            onStack(false);
+            return 0;
+        },
+        js_async_timer: () => {
+            onStack(false);
+            return 0;
+        },
+        js_async_resolve_pending: () => {
+            onStack(false);
+            return 0;
+        },
+    };
+    for (const imp of WebAssembly.Module.imports(wasmModule)) {
+        if (imp.module === 'wasi_snapshot_preview1') continue;
+        if (imp.module === 'env' && env[imp.name]) continue;
+        if (imp.kind !== 'function') throw new Error(`cannot stub ${imp.kind} import ${imp.module}.${imp.name}`);
+        imports[imp.module] ??= {};
+        imports[imp.module][imp.name] = () => {
+            throw new Error(`host import ${imp.module}.${imp.name} called while profiling`);
+        };
+    }
+    imports.env = { ...imports.env, ...env };
+
+    const instance = new WebAssembly.Instance(wasmModule, imports);
+    const ex = instance.exports;
+    wasi.initialize(instance);
+    if (hooks.onStack) {
+        if (!ex.asyncjmp_profile_enable) throw new Error(`${wasmPath} was not built with -DASYNCJMP_PROFILE`);
+        ex.asyncjmp_profile_enable();
+    }
+
+    const cstring = str => {
+        const bytes = Buffer.from(str + '\0', 'utf8');
+        const ptr = ex.malloc(bytes.length);
+        new Uint8Array(ex.memory.buffer, ptr, bytes.length).set(bytes);
+        return ptr;
+    };
+    const lastError = () => {
+        const mem = new Uint8Array(ex.memory.buffer);
+        const ptr = ex.zeroperl_last_error();
+        let end = ptr;
+        while (mem[end]) end++;
+        return Buffer.from(mem.subarray(ptr, end)).toString('utf8');
+    };
+    const check = (ok, what) => {
+        if (!ok) throw new Error(`${what} failed: ${lastError()}`);
+    };
+    const withString = (str, fn) => {
+        const ptr = cstring(str);
+        try {
+            return fn(ptr);
+        } finally {
+            ex.free(ptr);
+        }
+    };
+    const result = (res, what) => {
+        check(res !== 0, what);
+        ex.zeroperl_result_free(res);
+    };
+
+    const start = performance.now();
+    check(ex.zeroperl_init() === 0, 'zeroperl_init');
+    withString('zeroperl_profile_host', name => ex.zeroperl_register_function(HOST_FUNCTION_ID, name));
+    withString('zeroperl_profile_typed', name => withString('s>s',
+        sig => ex.zeroperl_register_function_ex(HOST_FUNCTION_ID, name, ZEROPERL_HOST_SUSPENDING, sig)));
+    withString(`sub zeroperl_profile_call { return scalar @_ }`,
+        code => check(ex.zeroperl_eval(code, ZEROPERL_VOID, 0, 0) === 0, 'zeroperl_eval'));
+
+    for (const { name, source } of workloads()) {
+        const file = `${MOUNT_DIR}/${name}`;
+        const src = ex.malloc(source.length);
+        new Uint8Array(ex.memory.buffer, src, source.length).set(source);
+        withString(file, p => check(ex.zeroperl_sfs_mount(p, src, source.length, ZEROPERL_SFS_COPY) === 0, `mount ${file}`));
+        ex.free(src);
+
+        withString(file, p => check(ex.zeroperl_run_file(p, 0, 0) === 0, `run_file ${name}`));
+        withString(`do '${file}'; die $@ if $@`,
+            code => check(ex.zeroperl_eval(code, ZEROPERL_SCALAR, 0, 0) === 0, `eval ${name}`));
+
+        const compiled = withString(`do '${file}'; die $@ if $@; 1`, code => ex.zeroperl_compile(code));
+        check(compiled !== 0, `compile ${name}`);
+        result(ex.zeroperl_exec(compiled, ZEROPERL_SCALAR, 0, 0), `exec ${name}`);
+        ex.zeroperl_code_free(compiled);
+    }
+
+    withString('zeroperl_profile_call',
+        name => result(ex.zeroperl_call(name, ZEROPERL_SCALAR, 0, 0), 'zeroperl_call'));
+    const sub = withString('zeroperl_profile_call', name => ex.zeroperl_resolve_sub(name));
+    check(sub !== 0, 'zeroperl_resolve_sub');
+    result(ex.zeroperl_call_code(sub, ZEROPERL_SCALAR, 0, 0), 'zeroperl_call_code');
+    ex.zeroperl_code_free(sub);
+
+    check(ex.zeroperl_reset() === 0, 'zeroperl_reset');
+    return performance.now() - start;
+}
+
+if (mode === 'record') {
+    const names = functionNames(fs.readFileSync(inputPath));
+    if (names.size === 0) throw new Error(`${inputPath} has no function names`);
+
+    Error.stackTraceLimit = Infinity;
+    const listed = new Set();
+    let stacks = 0, unrooted = 0;
+    // An unwind report is made from asyncjmp_profile_report, called by the
+    // function that goes on to call start_unwind; both frames are runtime
+    const onStack = skipRuntime => {
+        let frames = [...new Error().stack.matchAll(/wasm-function\[(\d+)\]/g)]
+            .map(m => names.get(Number(m[1])) ?? `wasm-function[${m[1]}]`);
+        if (skipRuntime) {
+            const report = frames.indexOf(REPORT_FRAME);
+            if (report < 0) throw new Error(`write to the profile descriptor outside ${REPORT_FRAME}`);
+            frames = frames.slice(report + 2);
+        }
+        const root = frames.indexOf(ROOT_FRAME);
+        if (root < 0) {
+            unrooted++;
+            return;
+        }
+        stacks++;
+        for (const frame of frames.slice(0, root)) {
+            if (RUNTIME_FRAMES.has(frame)) continue;
+            if (frame.startsWith('wasm-function[')) throw new Error(`no name for ${frame}`);
+            listed.add(frame);
+        }
+    };
+    run(inputPath, { onStack });
+
+    const known = new Set(names.values());
+    for (const name of ASYNC_EXPORTS) {
+        if (!known.has(name)) throw new Error(`${inputPath} has no function ${name}`);
+        listed.add(name);
+    }
+
+    fs.writeFileSync(outputPath, [...listed].sort().join('\n') + '\n');
+    console.log(`Wrote ${outputPath} (${listed.size} of ${names.size} functions, ${stacks} stacks, ${unrooted} outside ${ROOT_FRAME})`);
+} else {
+    const [baseline, candidate] = positional.map(wasmPath => {
+        const size = fs.statSync(wasmPath).size;
+        run(wasmPath);
+        const times = Array.from({ length: runs }, () => run(wasmPath));
+        const ms = times.reduce((a, b) => a + b, 0) / times.length;
+        console.log(`${wasmPath}: ${size} bytes, ${ms.toFixed(1)} ms mean over ${runs} runs`);
+        return { size, ms };
+    });
+    const pct = (a, b) => `${((b / a - 1) * 100).toFixed(1)}%`;
+    console.log(`size ${pct(baseline.size, candidate.size)}, time ${pct(baseline.ms, candidate.ms)}`);
+}
@@ -0,0 +1,212 @@
+#!/usr/bin/env node
+
+// Build-time pre-initialization, in the style of Wizer: instantiate the
+// module, run its init export, then write the resulting linear memory back
+// into the module's data segments so instances start already initialized.
+//
+// Wizer itself cannot be used here because zeroperl imports host functions
+// from "env"; those are stubbed with traps while the init export runs.
+
+const fs = require('node:fs');
+const { WASI } = require('node:wasi');
+
+const args = process.argv.slice(2);
+let inputPath = '';
+let outputPath = '';
+let initFunc = 'zeroperl_preinit';
+let maxGap = 64;
+
+function usage() {
+    console.error(`Usage: preinit.js -i <in.wasm> -o <out.wasm> [--init-func <export>] [--max-gap <bytes>]`);
+    process.exit(1);
+}
+
+for (let i = 0; i < args.length; i++) {
+    const arg = args[i];
+    if (arg === '-i') inputPath = args[++i];
+    else if (arg === '-o') outputPath = args[++i];
+    else if (arg === '--init-func') initFunc = args[++i];
+    else if (arg === '--max-gap') maxGap = Number(args[++i]);
+    else usage();
+}
+if (!inputPath || !outputPath) usage();
+
+const PAGE = 65536;
+const SEC_MEMORY = 5, SEC_EXPORT = 7, SEC_DATA = 11, SEC_DATACOUNT = 12;
+
+function readU32(buf, pos) {
+    let result = 0, shift = 0, byte;
+    do {
+        byte = buf[pos++];
+        result |= (byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return [result >>> 0, pos];
+}
+
+function u32(n) {
+    const out = [];
+    do {
+        let byte = n & 0x7f;
+        n >>>= 7;
+        if (n) byte |= 0x80;
+        out.push(byte);
+    } while (n);
+    return Buffer.from(out);
+}
+
+function i32(n) {
+    const out = [];
+    for (;;) {
+        const byte = n & 0x7f;
+        n >>= 7;
+        if ((n === 0 && !(byte & 0x40)) || (n === -1 && (byte & 0x40))) {
+            out.push(byte);
+            return Buffer.from(out);
+        }
+        out.push(byte | 0x80);
+    }
+}
+
+function section(id, body) {
+    return Buffer.concat([Buffer.from([id]), u32(body.length), body]);
+}
+
+function parseSections(bytes) {
+    const sections = [];
+    let pos = 8;
+    while (pos < bytes.length) {
+        const id = bytes[pos++];
+        let size;
+        [size, pos] = readU32(bytes, pos);
+        sections.push({ id, body: bytes.subarray(pos, pos + size) });
+        pos += size;
+    }
+    return sections;
+}
+
+// Rejects modules whose data segments are not all active: passive segments
+// are referenced by index from memory.init and cannot simply be replaced
+function checkDataSegments(body) {
+    let [count, pos] = readU32(body, 0);
+    for (let i = 0; i < count; i++) {
+        let flags;
+        [flags, pos] = readU32(body, pos);
+        if (flags !== 0) throw new Error(`data segment ${i} is not active (flags ${flags})`);
+        while (body[pos] !== 0x0b) pos++;
+        pos++;
+        let size;
+        [size, pos] = readU32(body, pos);
+        pos += size;
+    }
+}
+
+function rewriteMemory(body, pages) {
+    let [count, pos] = readU32(body, 0);
+    if (count !== 1) throw new Error(`expected one memory, found ${count}`);
+    const flags = body[pos++];
+    let min;
+    [min, pos] = readU32(body, pos);
+    const rest = body.subarray(pos);
+    return Buffer.concat([u32(1), Buffer.from([flags]), u32(Math.max(min, pages)), rest]);
+}
+
+function rewriteExports(body, drop) {
+    let [count, pos] = readU32(body, 0);
+    const kept = [];
+    for (let i = 0; i < count; i++) {
+        const start = pos;
+        let len;
+        [len, pos] = readU32(body, pos);
+        const name = body.subarray(pos, pos + len).toString('utf8');
+        pos += len + 1;
+        [, pos] = readU32(body, pos);
+        if (!drop.includes(name)) kept.push(body.subarray(start, pos));
+    }
+    return Buffer.concat([u32(kept.length), ...kept]);
+}
+
+// Non-zero runs of memory, merged across gaps of up to maxGap zero bytes so
+// the segment count stays well below engine limits
+function snapshotSegments(mem) {
+    const segments = [];
+    let i = 0;
+    while (i < mem.length) {
+        while (i < mem.length && mem[i] === 0) i++;
+        if (i >= mem.length) break;
+        const start = i;
+        let end = i, zeros = 0;
+        for (; i < mem.length && zeros <= maxGap; i++) {
+            if (mem[i] === 0) zeros++;
+            else { zeros = 0; end = i + 1; }
+        }
+        segments.push([start, end]);
+        i = end;
+    }
+    return segments;
+}
+
+const bytes = fs.readFileSync(inputPath);
+const wasmModule = new WebAssembly.Module(bytes);
+
+// Only ZEROPERL_* variables reach the module, so the build host's environment
+// does not end up in the snapshot
+const env = Object.fromEntries(Object.entries(process.env).filter(([k]) => k.startsWith('ZEROPERL_')));
+const wasi = new WASI({ version: 'preview1', env, args: ['zeroperl'] });
+const imports = { wasi_snapshot_preview1: wasi.wasiImport };
+for (const imp of WebAssembly.Module.imports(wasmModule)) {
+    if (imp.module === 'wasi_snapshot_preview1') continue;
+    if (imp.kind !== 'function') throw new Error(`cannot stub ${imp.kind} import ${imp.module}.${imp.name}`);
+    imports[imp.module] ??= {};
+    imports[imp.module][imp.name] = () => {
+        throw new Error(`host import ${imp.module}.${imp.name} called during pre-initialization`);
+    };
+}
+
+const instance = new WebAssembly.Instance(wasmModule, imports);
+const instanceExports = instance.exports;
+if (typeof instanceExports[initFunc] !== 'function') throw new Error(`module does not export ${initFunc}`);
+
+const globalsBefore = Object.entries(instanceExports)
+    .filter(([, v]) => v instanceof WebAssembly.Global)
+    .map(([k, v]) => [k, v.value]);
+
+wasi.initialize(instance);
+instanceExports[initFunc]();
+
+// Only linear memory is carried over; mutable globals (the stack pointer)
+// must be back at their initial values once the init export returns
+for (const [name, before] of globalsBefore) {
+    if (instanceExports[name].value !== before) throw new Error(`global ${name} changed during pre-initialization`);
+}
+
+const mem = new Uint8Array(instanceExports.memory.buffer);
+let segments = snapshotSegments(mem);
+while (segments.length > 50000) {
+    maxGap *= 2;
+    segments = snapshotSegments(mem);
+}
+const dataBody = Buffer.concat([
+    u32(segments.length),
+    ...segments.map(([start, end]) => Buffer.concat([
+        u32(0), Buffer.from([0x41]), i32(start), Buffer.from([0x0b]),
+        u32(end - start), Buffer.from(mem.subarray(start, end)),
+    ])),
+]);
+
+const out = [bytes.subarray(0, 8)];
+for (const { id, body } of parseSections(bytes)) {
+    if (id === SEC_MEMORY) out.push(section(id, rewriteMemory(body, mem.length / PAGE)));
+    else if (id === SEC_EXPORT) out.push(section(id, rewriteExports(body, ['_initialize', initFunc])));
+    else if (id === SEC_DATACOUNT) out.push(section(id, u32(segments.length)));
+    else if (id === SEC_DATA) {
+        checkDataSegments(body);
+        out.push(section(id, dataBody));
+    } else out.push(section(id, body));
+}
+
+const result = Buffer.concat(out);
+new WebAssembly.Module(result);
+fs.writeFileSync(outputPath, result);
+const dataBytes = segments.reduce((n, [s, e]) => n + e - s, 0);
+console.log(`Wrote ${outputPath} (${segments.length} data segments, ${dataBytes} bytes, ${mem.length / PAGE} pages)`);
@@ -0,0 +1,63 @@
+# Perl code called back from C: sort/map blocks, destructors, tie and
+# overload methods, regex code blocks, plus host calls from each of them
+use strict;
+use warnings;
+
+my $host = \&main::zeroperl_profile_host;
+
+my @list = sort { $host->($a, $b); $a <=> $b } reverse 1 .. 20;
+my @mapped = map { $host->($_) // $_ } grep { $_ % 2 } @list;
+my $sum = 0;
+$sum += $_ for @mapped;
+
+package Profile::Guard {
+    sub new { my ($class, $cb) = @_; bless { cb => $cb }, $class }
+    sub DESTROY { $_[0]{cb}->() }
+}
+for (1 .. 10) {
+    local $SIG{__WARN__} = sub { };
+    my $guard = Profile::Guard->new(sub { $host->('destroy') });
+    eval { my $inner = Profile::Guard->new(sub { die "in DESTROY\n" }) };
+}
+eval { my $g = Profile::Guard->new(sub { $host->('unwinding') }); die "unwind\n" };
+
+package Profile::Tied {
+    sub TIESCALAR { my $v = $_[1]; bless \$v, $_[0] }
+    sub FETCH { $host->('fetch'); ${ $_[0] } }
+    sub STORE { die "read-only\n" if ${ $_[0] } eq 'ro'; ${ $_[0] } = $_[1] }
+}
+tie my $tied, 'Profile::Tied', 'rw';
+$tied = 5;
+$sum += $tied;
+tie my $ro, 'Profile::Tied', 'ro';
+eval { $ro = 1 };
+
+package Profile::Num {
+    use overload
+        '+'  => sub { $host->('add'); Profile::Num->new($_[0]{v} + (ref $_[1] ? $_[1]{v} : $_[1])) },
+        '""' => sub { "num($_[0]{v})" },
+        '<=>' => sub { my ($x, $y, $swap) = @_; my $r = $x->{v} <=> (ref $y ? $y->{v} : $y); $swap ? -$r : $r },
+        'bool' => sub { die "no bool\n" if $_[0]{v} < 0; $_[0]{v} };
+    sub new { bless { v => $_[1] }, $_[0] }
+}
+my $num = Profile::Num->new(1);
+$num = $num + $_ for 1 .. 10;
+my $str = "$num";
+my @nums = sort { $a <=> $b } map { Profile::Num->new($_) } 5, 3, 9;
+eval { if (Profile::Num->new(-1)) { } };
+
+my $count = 0;
+"abcabcabc" =~ /(?:abc(?{ $count++; $host->('re') }))*/;
+eval { "xyz" =~ /x(?{ die "in regex\n" })/ };
+my $s = "a1b2c3";
+$s =~ s{(\d)}{$host->($1) // $1 * 2}ge;
+
+my $typed = \&main::zeroperl_profile_typed;
+my @typed = sort { ($typed->("$a") // $a) <=> ($typed->("$b") // $b) } 1 .. 10;
+eval { $typed->() };
+
+my $code = sub { $host->(@_) };
+$code->($_) for 1 .. 10;
+eval { local $SIG{ALRM} = sub { }; $host->('in eval') };
+
+$sum;
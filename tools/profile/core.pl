@@ -0,0 +1,44 @@
+# Exceptions and non-local exits: every die/eval pair is a setjmp and a
+# longjmp, from subs, string evals, nested evals and sort/loop bodies
+use strict;
+use warnings;
+
+my $n = 0;
+for my $i (1 .. 50) {
+    eval { die "plain\n" };
+    $n++ if $@ eq "plain\n";
+    eval { eval { die { code => $i } }; die $@ if ref $@ };
+    $n++ if ref $@ eq 'HASH';
+    eval "die 'string eval'";
+    $n++ if $@;
+    my $v = eval "1 + $i";
+    $n += $v - $i;
+}
+
+sub thrower { my $d = shift; $d ? thrower($d - 1) : die "deep\n" }
+eval { thrower(50) };
+$n++ if $@ eq "deep\n";
+
+eval { local $SIG{__DIE__} = sub { $n++ }; die "handled\n" };
+eval { local $SIG{__WARN__} = sub { die "from warn\n" }; warn "w\n" };
+$n++ if $@ eq "from warn\n";
+
+OUTER: for my $i (1 .. 10) {
+    for my $j (1 .. 10) {
+        next OUTER if $j > $i;
+        last OUTER if $i * $j > 50;
+    }
+}
+
+my @sorted = eval { sort { $a <=> $b or die "tie\n" } 3, 1, 2 };
+eval { my @x = map { die "map\n" if $_ == 5; $_ } 1 .. 10 };
+eval { my %h; $h{$_}++ for 1 .. 10; die "loop\n" };
+
+eval { require Nonexistent::Module::For::Profile };
+$n++ if $@;
+eval { my $x = 1 / 0 };
+$n++ if $@;
+eval { my $x = undef; no warnings; $x->method };
+$n++ if $@;
+
+$n;
@@ -0,0 +1,44 @@
+# Module loading and library code: require/import, compile-time BEGIN
+# blocks and the XS and pure-Perl modules most scripts pull in
+use strict;
+use warnings;
+
+require List::Util;
+require Scalar::Util;
+require Data::Dumper;
+require Encode;
+require MIME::Base64;
+require Digest::MD5;
+require Digest::SHA;
+require File::Spec;
+require Time::Local;
+require JSON::PP;
+
+my @l = List::Util::shuffle(1 .. 100);
+my $max = List::Util::reduce(sub { $a > $b ? $a : $b }, @l);
+my $first = List::Util::first(sub { $_ > 50 }, @l);
+local $Data::Dumper::Indent = 1;
+my $dump = Data::Dumper::Dumper({ list => [1 .. 5], nested => { a => [1, { b => 2 }] } });
+my $bytes = Encode::encode('UTF-8', "caf\x{e9} \x{263a}");
+my $chars = Encode::decode('UTF-8', $bytes);
+eval { Encode::decode('UTF-8', "\xff\xfe", Encode::FB_CROAK()) };
+my $b64 = MIME::Base64::encode_base64($bytes);
+my $md5 = Digest::MD5::md5_hex($dump);
+my $sha = Digest::SHA::sha256_hex($dump);
+my $json = JSON::PP->new->canonical->encode({ a => [1, 2, 3], b => { c => 'd' } });
+my $data = JSON::PP->new->decode($json);
+eval { JSON::PP->new->decode('{"broken":') };
+
+my $string = sprintf "%s %d %.3f %x", $chars, $max, 3.14159, $first;
+my @parts = split /\s+/, $string;
+my %count;
+$count{$_}++ for map { lc } @parts;
+
+open my $fh, '<', __FILE__ or die "open: $!";
+my $lines = () = <$fh>;
+close $fh;
+
+eval "use Module::That::Does::Not::Exist; 1";
+eval q{ BEGIN { die "in BEGIN\n" } };
+
+$lines;
@@ -2,15 +2,19 @@
 
 const fs = require('node:fs');
 const path = require('node:path');
+const zlib = require('node:zlib');
 
 const args = process.argv.slice(2);
 let inputPath = '';
 let outputPath = '';
 let prefix = '';
 let skipRegex = '';
+let compress = false;
+let compressMin = 512;
+const incDirs = [];
 
 function usage() {
-    console.error(`Usage: sfs.js -i <dir> -o <header> [--prefix <prefix>] [--skip <regex>]`);
+    console.error(`Usage: sfs.js -i <dir> -o <header> [--prefix <prefix>] [--skip <regex>] [--compress] [--compress-min <bytes>] [--inc <dir>]...`);
     process.exit(1);
 }
 
@@ -20,17 +24,22 @@ for (let i = 0; i < args.length; i++) {
     else if (arg === '-o' || arg === '--output-path') outputPath = args[++i];
     else if (arg === '--prefix') prefix = args[++i];
     else if (arg === '--skip') skipRegex = args[++i];
+    else if (arg === '--compress') compress = true;
+    else if (arg === '--compress-min') compressMin = Number(args[++i]);
+    else if (arg === '--inc') incDirs.push(args[++i]);
     else if (arg.startsWith('--')) {
         const [key, val] = arg.slice(2).split('=');
         if (key === 'input-path') inputPath = val;
         else if (key === 'output-path') outputPath = val;
         else if (key === 'prefix') prefix = val;
         else if (key === 'skip') skipRegex = val;
+        else if (key === 'compress-min') { compress = true; compressMin = Number(val); }
+        else if (key === 'inc') incDirs.push(val);
         else usage();
     } else usage();
 }
 
-if (!inputPath || !outputPath) usage();
+if (!inputPath || !outputPath || !(compressMin >= 0)) usage();
 
 inputPath = path.resolve(inputPath);
 if (!fs.existsSync(inputPath) || !fs.statSync(inputPath).isDirectory()) {
@@ -40,47 +49,171 @@ if (!fs.existsSync(inputPath) || !fs.statSync(inputPath).isDirectory()) {
 
 const relpaths = [];
 const fileDatas = [];
+// Directory tree: each directory lists its children as { name, file } or
+// { name, dir } indexes into relpaths / dirs
+const dirs = [];
 
 function traverse(dir) {
+    const node = { rel: path.relative(inputPath, dir).split(path.sep).join('/'), children: [] };
+    const index = dirs.push(node) - 1;
     for (const entry of fs.readdirSync(dir)) {
         if (entry.startsWith('.')) continue;
         const fullPath = path.join(dir, entry);
         const stat = fs.statSync(fullPath);
         const rel = path.relative(inputPath, fullPath);
         if (skipRegex && new RegExp(skipRegex).test(rel)) continue;
-        if (stat.isDirectory()) traverse(fullPath);
+        if (stat.isDirectory()) node.children.push({ name: entry, dir: traverse(fullPath) });
         else if (stat.isFile()) {
+            node.children.push({ name: entry, file: relpaths.length });
             relpaths.push(rel.split(path.sep).join('/'));
             fileDatas.push(fs.readFileSync(fullPath));
         }
     }
+    return index;
 }
 traverse(inputPath);
 
+// Files at least compressMin bytes long are stored as zlib streams when that
+// actually saves space; the runtime inflates them on first open.
+const sizes = fileDatas.map(data => data.length);
+const compressed = fileDatas.map(() => false);
+const storedDatas = fileDatas.map((data, i) => {
+    if (!compress || data.length < compressMin) return data;
+    const packed = zlib.deflateSync(data, { level: 9 });
+    if (packed.length >= data.length) return data;
+    compressed[i] = true;
+    return packed;
+});
+
 const offsets = [];
 let totalSize = 0;
-for (const data of fileDatas) {
+for (const data of storedDatas) {
     offsets.push(totalSize);
     totalSize += data.length;
 }
 
-const allData = Buffer.concat(fileDatas, totalSize);
+const allData = Buffer.concat(storedDatas, totalSize);
+const rawSize = sizes.reduce((a, b) => a + b, 0);
+const numCompressed = compressed.filter(Boolean).length;
+
+const vpaths = relpaths.map(rel => prefix ? path.posix.join(prefix, rel) : rel);
+
+// FNV-1a over the UTF-8 bytes of the virtual path; must match sfs_path_hash()
+function fnv1a(str) {
+    let h = 0x811c9dc5;
+    for (const b of Buffer.from(str, 'utf8')) {
+        h ^= b;
+        h = Math.imul(h, 0x01000193) >>> 0;
+    }
+    return h >>> 0;
+}
+
+// Open-addressed path index, kept at most half full so probes stay short.
+// Slots hold entry index + 1; zero marks an empty slot.
+function buildIndex(hashes) {
+    let size = 1;
+    while (size < hashes.length * 2) size <<= 1;
+    const slots = new Uint32Array(size);
+    hashes.forEach((h, i) => {
+        let slot = h & (size - 1);
+        while (slots[slot] !== 0) slot = (slot + 1) & (size - 1);
+        slots[slot] = i + 1;
+    });
+    return slots;
+}
+
+const hashes = vpaths.map(fnv1a);
+const index = buildIndex(hashes);
+
+const dirVpaths = dirs.map(d => prefix ? path.posix.join(prefix, d.rel) : d.rel);
+const dirHashes = dirVpaths.map(fnv1a);
+const dirIndex = buildIndex(dirHashes);
+
+// Module index for the @INC hook: maps a require name ("Foo/Bar.pm") to the
+// file in the first --inc directory (in @INC order) that provides it
+const incRels = incDirs.map(d => path.posix.normalize(d.split(path.sep).join('/')).replace(/^\.?\/+|\/+$/g, ''));
+const incVpaths = incRels.map(rel => prefix ? path.posix.join(prefix, rel) : rel);
+const modules = new Map();
+incRels.forEach((incRel, inc) => {
+    relpaths.forEach((rel, entry) => {
+        if (!rel.startsWith(incRel + '/')) return;
+        const name = rel.slice(incRel.length + 1);
+        if (!modules.has(name)) modules.set(name, { entry, inc });
+    });
+});
+const moduleNames = [...modules.keys()];
+const moduleHashes = moduleNames.map(fnv1a);
+const moduleIndex = buildIndex(moduleHashes);
 
 const header = `#ifndef SFS_H
 #define SFS_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #define SFS_BUILTIN_PREFIX "${prefix}"
+#define SFS_INDEX_SIZE ${index.length}u
+#define SFS_DIR_INDEX_SIZE ${dirIndex.length}u
+#define SFS_MODULE_INDEX_SIZE ${moduleIndex.length}u
+#define SFS_INC_DIRS_NUM ${incVpaths.length}u
+#define SFS_HAS_COMPRESSED ${numCompressed > 0 ? 1 : 0}
 
 struct sfs_entry {
     const char *abspath;
-    const unsigned char *start;
+    const unsigned char *start; /* stored bytes (zlib stream if compressed) */
     const unsigned char *end;
+    size_t size;                /* size of the file contents */
+    uint32_t hash;
+    unsigned char compressed;
+};
+
+/* One name inside an embedded directory; index points into sfs_entries or,
+   for subdirectories, sfs_dirs */
+struct sfs_dirent {
+    const char *name;
+    uint32_t index;
+    unsigned char is_dir;
+};
+
+/* An embedded directory and its children sfs_dirents[first .. first+count) */
+struct sfs_dir {
+    const char *abspath;
+    uint32_t hash;
+    uint32_t first;
+    uint32_t count;
 };
 
 extern size_t sfs_builtin_files_num;
 extern const struct sfs_entry sfs_entries[];
+extern const uint32_t sfs_index[SFS_INDEX_SIZE];
+
+extern size_t sfs_builtin_dirs_num;
+extern const struct sfs_dir sfs_dirs[];
+extern const struct sfs_dirent sfs_dirents[];
+extern const uint32_t sfs_dir_index[SFS_DIR_INDEX_SIZE];
+
+/* A require name resolved to the sfs_entries file that @INC would find;
+   inc indexes sfs_inc_dirs, the embedded @INC directory providing it */
+struct sfs_module {
+    const char *name;
+    uint32_t hash;
+    uint32_t entry;
+    uint32_t inc;
+};
+
+extern size_t sfs_builtin_modules_num;
+extern const struct sfs_module sfs_modules[];
+extern const uint32_t sfs_module_index[SFS_MODULE_INDEX_SIZE];
+extern const char *const sfs_inc_dirs[];
+
+static inline uint32_t sfs_path_hash(const char *path, size_t len) {
+    uint32_t h = 0x811c9dc5u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)path[i];
+        h *= 0x01000193u;
+    }
+    return h;
+}
 
 #endif
 `;
@@ -90,16 +223,43 @@ console.log(`Wrote header: ${outputPath}`);
 
 const binPath = outputPath.replace(/(\.h)?$/, '_data.bin');
 fs.writeFileSync(binPath, allData);
-console.log(`Wrote binary: ${binPath} (${allData.length} bytes)`);
+console.log(`Wrote binary: ${binPath} (${allData.length} bytes, ${rawSize} uncompressed, ${numCompressed} files compressed)`);
+
+const entries = vpaths.map((vpath, i) => {
+    return `    { "${vpath.replace(/"/g, '\\"')}", sfs_builtin_data + ${offsets[i]}, sfs_builtin_data + ${offsets[i]} + ${storedDatas[i].length}, ${sizes[i]}, 0x${hashes[i].toString(16)}u, ${compressed[i] ? 1 : 0} },`;
+}).join('\n');
 
-const entries = relpaths.map((rel, i) => {
-    const vpath = prefix ? path.posix.join(prefix, rel) : rel;
-    return `    { "${vpath.replace(/"/g, '\\"')}", sfs_builtin_data + ${offsets[i]}, sfs_builtin_data + ${offsets[i]} + ${fileDatas[i].length} },`;
+function indexRows(slots) {
+    const rows = [];
+    for (let i = 0; i < slots.length; i += 16) {
+        rows.push('    ' + Array.from(slots.subarray(i, i + 16)).join(', ') + ',');
+    }
+    return rows.join('\n');
+}
+
+const cString = str => `"${str.replace(/\\/g, '\\\\').replace(/"/g, '\\"')}"`;
+
+let numDirents = 0;
+const dirRows = dirs.map((d, i) => {
+    const first = numDirents;
+    numDirents += d.children.length;
+    return `    { ${cString(dirVpaths[i])}, 0x${dirHashes[i].toString(16)}u, ${first}, ${d.children.length} },`;
+}).join('\n');
+
+const moduleRows = moduleNames.map((name, i) => {
+    const { entry, inc } = modules.get(name);
+    return `    { ${cString(name)}, 0x${moduleHashes[i].toString(16)}u, ${entry}, ${inc} },`;
 }).join('\n');
 
+const incRows = incVpaths.map(v => `    ${cString(v)},`).join('\n');
+
+const direntRows = dirs.flatMap(d => d.children.map(c =>
+    `    { ${cString(c.name)}, ${c.dir !== undefined ? c.dir : c.file}, ${c.dir !== undefined ? 1 : 0} },`
+)).join('\n');
+
 const dataC = `#include "${path.basename(outputPath)}"
 
-size_t sfs_builtin_files_num = ${fileDatas.length};
+size_t sfs_builtin_files_num = ${storedDatas.length};
 
 static const unsigned char sfs_builtin_data[] = {
 #embed "${binPath}"
@@ -108,6 +268,38 @@ static const unsigned char sfs_builtin_data[] = {
 const struct sfs_entry sfs_entries[] = {
 ${entries}
 };
+
+const uint32_t sfs_index[SFS_INDEX_SIZE] = {
+${indexRows(index)}
+};
+
+size_t sfs_builtin_dirs_num = ${dirs.length};
+
+const struct sfs_dir sfs_dirs[] = {
+${dirRows}
+};
+
+const struct sfs_dirent sfs_dirents[] = {
+${direntRows}
+};
+
+const uint32_t sfs_dir_index[SFS_DIR_INDEX_SIZE] = {
+${indexRows(dirIndex)}
+};
+
+size_t sfs_builtin_modules_num = ${moduleNames.length};
+
+const struct sfs_module sfs_modules[] = {
+${moduleRows}
+};
+
+const uint32_t sfs_module_index[SFS_MODULE_INDEX_SIZE] = {
+${indexRows(moduleIndex)}
+};
+
+const char *const sfs_inc_dirs[] = {
+${incRows}
+};
 `;
 
 const dataPath = outputPath.replace(/(\.h)?$/, '_data.c');